@@ -0,0 +1,308 @@
+/*
+ * File: animator.cpp
+ * ------------------
+ * This file implements the Animator class.
+ */
+
+#include "animator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+/*
+ * Implementation notes: easing
+ * ----------------------------
+ * Every curve is k1 p + k2 p^2 + k3 p^3 for progress p from 0 to 1: p,
+ * p^2, 2p - p^2 and the smoothstep 3p^2 - 2p^3.
+ */
+void easingCoefficients(Easing easing, double & k1, double & k2, double & k3) {
+    switch (easing) {
+    case EASE_IN:
+        k1 = 0, k2 = 1, k3 = 0;
+        break;
+    case EASE_OUT:
+        k1 = 2, k2 = -1, k3 = 0;
+        break;
+    case EASE_IN_OUT:
+        k1 = 0, k2 = 3, k3 = -2;
+        break;
+    default:
+        k1 = 1, k2 = 0, k3 = 0;
+        break;
+    }
+}
+
+GRectangle enclose(const GRectangle & a, const GRectangle & b) {
+    double left = min(a.getX(), b.getX());
+    double top = min(a.getY(), b.getY());
+    double right = max(a.getX() + a.getWidth(), b.getX() + b.getWidth());
+    double bottom = max(a.getY() + a.getHeight(), b.getY() + b.getHeight());
+    return GRectangle(left, top, right - left, bottom - top);
+}
+
+int toChannel(double value) {
+    return max(0, min(255, (int) lround(value)));
+}
+
+}
+
+int Animator::Track::size() const {
+    return (int) shapes.size();
+}
+
+void Animator::Track::clear() {
+    shapes.clear();
+    types.clear();
+    elapsed.clear();
+    duration.clear();
+    k1.clear();
+    k2.clear();
+    k3.clear();
+    for (int c = 0; c < CHANNELS; c++) {
+        from[c].clear();
+        delta[c].clear();
+        value[c].clear();
+    }
+    slots.clear();
+}
+
+Animator::Animator(ShapeList & shapes) : shapes(shapes) {
+}
+
+void Animator::moveTo(Shape *sp, double x, double y, double milliseconds,
+                      Easing easing) {
+    GPoint location = sp->getLocation();
+    double from[CHANNELS] = { location.getX(), location.getY(), 0 };
+    double to[CHANNELS] = { x, y, 0 };
+    start(TRACK_POSITION, sp, from, to, milliseconds, easing);
+}
+
+void Animator::resizeTo(Shape *sp, double width, double height,
+                        double milliseconds, Easing easing) {
+    ShapeType type;
+    if (dynamic_cast<Square *>(sp) != nullptr) {
+        type = SHAPE_SQUARE;
+        height = width;
+    } else if (dynamic_cast<Rect *>(sp) != nullptr) {
+        type = SHAPE_RECT;
+    } else if (dynamic_cast<Oval *>(sp) != nullptr) {
+        type = SHAPE_OVAL;
+    } else {
+        throw runtime_error("Animator::resizeTo: Shape cannot be resized");
+    }
+    GRectangle bounds = sp->getBounds();
+    double from[CHANNELS] = { bounds.getWidth(), bounds.getHeight(), 0 };
+    double to[CHANNELS] = { width, height, 0 };
+    start(TRACK_SIZE, sp, from, to, milliseconds, easing, type);
+}
+
+void Animator::colorTo(Shape *sp, string_view color, double milliseconds,
+                       Easing easing) {
+    ColorId target = resolveColor(color);
+    if (!target.isValid()) {
+        throw runtime_error("Animator::colorTo: Undefined color");
+    }
+    ColorId current = sp->getColorId();
+    int rgb = current.isValid() ? current.getRGB() : 0;
+    int goal = target.getRGB();
+    double from[CHANNELS] = { double(rgb >> 16), double((rgb >> 8) & 0xFF),
+                              double(rgb & 0xFF) };
+    double to[CHANNELS] = { double(goal >> 16), double((goal >> 8) & 0xFF),
+                            double(goal & 0xFF) };
+    start(TRACK_COLOR, sp, from, to, milliseconds, easing);
+}
+
+void Animator::start(TrackKind kind, Shape *sp, const double *from,
+                     const double *to, double milliseconds, Easing easing,
+                     ShapeType type) {
+    Track & track = tracks[kind];
+    auto found = track.slots.find(sp);
+    int i;
+    if (found == track.slots.end()) {
+        i = track.size();
+        track.shapes.push_back(sp);
+        track.types.push_back(0);
+        track.elapsed.push_back(0);
+        track.duration.push_back(0);
+        track.k1.push_back(0);
+        track.k2.push_back(0);
+        track.k3.push_back(0);
+        for (int c = 0; c < CHANNELS; c++) {
+            track.from[c].push_back(0);
+            track.delta[c].push_back(0);
+            track.value[c].push_back(0);
+        }
+        track.slots[sp] = i;
+    } else {
+        i = found->second;
+    }
+    track.types[i] = (uint8_t) type;
+    track.elapsed[i] = 0;
+    track.duration[i] = max(milliseconds, 0.0);
+    easingCoefficients(easing, track.k1[i], track.k2[i], track.k3[i]);
+    for (int c = 0; c < CHANNELS; c++) {
+        track.from[c][i] = from[c];
+        track.delta[c][i] = to[c] - from[c];
+        track.value[c][i] = from[c];
+    }
+}
+
+void Animator::cancel(Shape *sp) {
+    for (Track & track : tracks) {
+        auto found = track.slots.find(sp);
+        if (found != track.slots.end()) removeAt(track, found->second);
+    }
+}
+
+void Animator::clear() {
+    for (Track & track : tracks) {
+        track.clear();
+    }
+    dirty.clear();
+}
+
+int Animator::size() const {
+    int count = 0;
+    for (const Track & track : tracks) {
+        count += track.size();
+    }
+    return count;
+}
+
+bool Animator::isEmpty() const {
+    return size() == 0;
+}
+
+void Animator::advance(double milliseconds) {
+    dirty.clear();
+    if (isEmpty()) return;
+    for (Track & track : tracks) {
+        int n = track.size();
+        double *elapsed = track.elapsed.data();
+        const double *duration = track.duration.data();
+        const double *k1 = track.k1.data();
+        const double *k2 = track.k2.data();
+        const double *k3 = track.k3.data();
+        const double *from0 = track.from[0].data();
+        const double *from1 = track.from[1].data();
+        const double *from2 = track.from[2].data();
+        const double *delta0 = track.delta[0].data();
+        const double *delta1 = track.delta[1].data();
+        const double *delta2 = track.delta[2].data();
+        double *value0 = track.value[0].data();
+        double *value1 = track.value[1].data();
+        double *value2 = track.value[2].data();
+        for (int i = 0; i < n; i++) {
+            elapsed[i] += milliseconds;
+            double p = (elapsed[i] >= duration[i]) ? 1 : elapsed[i] / duration[i];
+            double eased = p * (k1[i] + p * (k2[i] + p * k3[i]));
+            value0[i] = from0[i] + delta0[i] * eased;
+            value1[i] = from1[i] + delta1[i] * eased;
+            value2[i] = from2[i] + delta2[i] * eased;
+        }
+    }
+    shapes.beginUpdate();
+    for (int kind = 0; kind < TRACK_COUNT; kind++) {
+        writeBack(TrackKind(kind));
+    }
+    shapes.endUpdate();
+    for (Track & track : tracks) {
+        removeFinished(track);
+    }
+}
+
+// Stores the values of the track in its shapes and records what changed
+void Animator::writeBack(TrackKind kind) {
+    Track & track = tracks[kind];
+    for (int i = 0; i < track.size(); i++) {
+        Shape *sp = track.shapes[i];
+        double v0 = track.value[0][i];
+        double v1 = track.value[1][i];
+        if (kind == TRACK_COLOR) {
+            int rgb = toChannel(v0) << 16 | toChannel(v1) << 8
+                    | toChannel(track.value[2][i]);
+            if (sp->getColorId() == ColorId(rgb)) continue;
+            static const char HEX[] = "0123456789abcdef";
+            char name[7] = { '#' };
+            for (int k = 0; k < 6; k++) {
+                name[6 - k] = HEX[(rgb >> (4 * k)) & 0xF];
+            }
+            sp->setColor(string(name, 7));
+            dirty.push_back(sp->getBounds());
+            continue;
+        }
+        GRectangle before = sp->getBounds();
+        if (kind == TRACK_POSITION) {
+            sp->setLocation(v0, v1);
+        } else if (track.types[i] == SHAPE_SQUARE) {
+            static_cast<Square *>(sp)->setSize(v0);
+        } else if (track.types[i] == SHAPE_RECT) {
+            static_cast<Rect *>(sp)->setSize(v0, v1);
+        } else {
+            static_cast<Oval *>(sp)->setSize(v0, v1);
+        }
+        dirty.push_back(enclose(before, sp->getBounds()));
+    }
+}
+
+void Animator::removeFinished(Track & track) {
+    for (int i = track.size() - 1; i >= 0; i--) {
+        if (track.elapsed[i] >= track.duration[i]) removeAt(track, i);
+    }
+}
+
+void Animator::removeAt(Track & track, int index) {
+    int last = track.size() - 1;
+    track.slots.erase(track.shapes[index]);
+    if (index != last) {
+        track.shapes[index] = track.shapes[last];
+        track.types[index] = track.types[last];
+        track.elapsed[index] = track.elapsed[last];
+        track.duration[index] = track.duration[last];
+        track.k1[index] = track.k1[last];
+        track.k2[index] = track.k2[last];
+        track.k3[index] = track.k3[last];
+        for (int c = 0; c < CHANNELS; c++) {
+            track.from[c][index] = track.from[c][last];
+            track.delta[c][index] = track.delta[c][last];
+            track.value[c][index] = track.value[c][last];
+        }
+        track.slots[track.shapes[index]] = index;
+    }
+    track.shapes.pop_back();
+    track.types.pop_back();
+    track.elapsed.pop_back();
+    track.duration.pop_back();
+    track.k1.pop_back();
+    track.k2.pop_back();
+    track.k3.pop_back();
+    for (int c = 0; c < CHANNELS; c++) {
+        track.from[c].pop_back();
+        track.delta[c].pop_back();
+        track.value[c].pop_back();
+    }
+}
+
+const vector<GRectangle> & Animator::getDirtyRegions() const {
+    return dirty;
+}
+
+void Animator::run(GWindow & gw, double fps) {
+    double interval = 1000 / fps;
+    chrono::steady_clock::time_point last = chrono::steady_clock::now();
+    while (!isEmpty()) {
+        pause(interval);
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        advance(chrono::duration<double, milli>(now - last).count());
+        last = now;
+        gw.clear();
+        shapes.draw(gw);
+    }
+    gw.repaint();
+}
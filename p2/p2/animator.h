@@ -0,0 +1,150 @@
+/*
+* File: animator.h
+* ----------------
+* This file defines an Animator class that moves, resizes and recolors
+* shapes over time, advancing every animation together once per frame.
+*/
+#ifndef _animator_h
+#define _animator_h
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "gtypes.h"
+#include "gwindow.h"
+#include "shapelist.h"
+/*
+* Type: Easing
+* ------------
+* How an animation's progress follows time: at a constant rate, speeding
+* up from rest, slowing down to rest, or both.
+*/
+enum Easing {
+EASE_LINEAR,
+EASE_IN,
+EASE_OUT,
+EASE_IN_OUT
+};
+/*
+* Class: Animator
+* ---------------
+* Animates the shapes of a ShapeList from their current location, size or
+* color to a target over a given number of milliseconds. Instead of a
+* timer per shape, the frame loop calls advance once per frame, which
+* steps every animation in one pass over arrays of numbers and then
+* writes the results to the shapes as one update group of the list, so
+* the generation advances once per frame. A shape can have one animation
+* of each kind at a time; starting another of the same kind replaces it.
+* Animations must be canceled before their shape is deleted.
+*/
+class Animator {
+public:
+/*
+* Constructor: Animator
+* Usage: Animator animator(shapes);
+* ---------------------------------
+* Creates an animator for shapes in the given list, which must outlive it.
+*/
+explicit Animator(ShapeList & shapes);
+/*
+* Methods: moveTo, resizeTo, colorTo
+* Usage: animator.moveTo(sp, x, y, milliseconds);
+* animator.resizeTo(sp, width, height, milliseconds, EASE_OUT);
+* animator.colorTo(sp, "#ff8000", milliseconds);
+* ----------------------------------------------
+* Start animating the location of sp, as set by setLocation, its size, or
+* its color. Only rectangles, squares and ovals can be resized, and a
+* square takes width as its size. resizeTo and colorTo signal an error if
+* sp cannot be resized or the color is not defined. An animation with a
+* duration of 0 finishes at the next call to advance.
+*/
+void moveTo(Shape *sp, double x, double y, double milliseconds,
+Easing easing = EASE_LINEAR);
+void resizeTo(Shape *sp, double width, double height, double milliseconds,
+Easing easing = EASE_LINEAR);
+void colorTo(Shape *sp, std::string_view color, double milliseconds,
+Easing easing = EASE_LINEAR);
+/*
+* Methods: cancel, clear
+* Usage: animator.cancel(sp);
+* animator.clear();
+* -----------------
+* Stop the animations of sp, or of every shape, leaving the shapes as they
+* are.
+*/
+void cancel(Shape *sp);
+void clear();
+/*
+* Methods: size, isEmpty
+* Usage: if (animator.isEmpty()) ...
+* ----------------------------------
+* Return the number of animations still running.
+*/
+int size() const;
+bool isEmpty() const;
+/*
+* Method: advance
+* Usage: animator.advance(milliseconds);
+* --------------------------------------
+* Advances every animation by the given time, updates the shapes, and
+* drops the animations that have finished.
+*/
+void advance(double milliseconds);
+/*
+* Method: getDirtyRegions
+* Usage: for (const GRectangle & r : animator.getDirtyRegions()) ...
+* ------------------------------------------------------------------
+* Returns the parts of the scene changed by the last call to advance: for
+* each shape updated, a rectangle enclosing its bounds before and after.
+* The rectangles may overlap. Nothing outside them needs to be redrawn.
+*/
+const std::vector<GRectangle> & getDirtyRegions() const;
+/*
+* Method: run
+* Usage: animator.run(gw);
+* ------------------------
+* Animates until every animation has finished, as a simple alternative to
+* driving advance from a frame loop. Each frame redraws the list on gw and
+* waits with pause, which also repaints the window, advancing the
+* animations by the time that actually passed.
+*/
+void run(GWindow & gw, double fps = 60);
+private:
+/*
+* Implementation notes: Animator
+* ------------------------------
+* Each kind of animation has a Track that keeps its animations as columns
+* of equal length, up to three channels of them (x and y, width and
+* height, or red, green and blue). The easing curve of each animation is
+* stored as the coefficients of a cubic in its progress, so a single loop
+* with no branches computes every value, and the compiler can vectorize
+* it. Finished animations are removed by moving the last one into their
+* place, and slots maps each shape to its index in the track.
+*/
+enum TrackKind {
+TRACK_POSITION,
+TRACK_SIZE,
+TRACK_COLOR,
+TRACK_COUNT
+};
+static const int CHANNELS = 3;
+struct Track {
+std::vector<Shape *> shapes;
+std::vector<uint8_t> types;   // The ShapeType of a resized shape
+std::vector<double> elapsed, duration;
+std::vector<double> k1, k2, k3;
+std::vector<double> from[CHANNELS], delta[CHANNELS], value[CHANNELS];
+std::unordered_map<Shape *, int> slots;
+int size() const;
+void clear();
+};
+void start(TrackKind kind, Shape *sp, const double *from, const double *to,
+double milliseconds, Easing easing, ShapeType type = ShapeType());
+void writeBack(TrackKind kind);
+void removeFinished(Track & track);
+void removeAt(Track & track, int index);
+ShapeList & shapes;
+Track tracks[TRACK_COUNT];
+std::vector<GRectangle> dirty;
+};
+#endif
@@ -0,0 +1,181 @@
+/*
+ * File: bench_pick.cpp
+ * --------------------
+ * This file is a standalone program that measures ShapeList::getShapeAt
+ * against a plain scan of the list from the front, to check and tune the
+ * rule that decides when getShapeAt builds its pick index.
+ *
+ * The first table runs on scenes that do not change. For each size it
+ * gives the cost of a scan, of building a ShapeIndex, and of a query once
+ * getShapeAt has built one, and the number of queries after which the
+ * build has paid for itself. getShapeAt builds after its scans have
+ * visited PICK_INDEX_FACTOR times as many shapes as the list holds, and
+ * only for lists of at least PICK_INDEX_MIN shapes.
+ *
+ * The second table moves one shape after every few queries, so the index
+ * is rebuilt or skipped as the rule decides, and compares the average
+ * query with the scan.
+ *
+ * Usage: bench_pick [queries]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "shapeindex.h"
+#include "shapelist.h"
+
+using namespace std;
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+// The plane grows with the scene, so the shapes per point stay constant
+double sideFor(int count) {
+    return sqrt((double) count) * 20;
+}
+
+void fillScene(ShapeList & shapes, int count, mt19937 & rng) {
+    uniform_real_distribution<double> position(0, sideFor(count));
+    uniform_real_distribution<double> size(1, 40);
+    for (int i = 0; i < count; i++) {
+        double x = position(rng);
+        double y = position(rng);
+        switch (i % 4) {
+        case 0: shapes.add(new Rect(x, y, size(rng), size(rng))); break;
+        case 1: shapes.add(new Square(x, y, size(rng))); break;
+        case 2: shapes.add(new Oval(x, y, size(rng), size(rng))); break;
+        default: shapes.add(new Line(x, y, x + size(rng), y + size(rng))); break;
+        }
+    }
+}
+
+void deleteScene(ShapeList & shapes) {
+    vector<Shape *> all(shapes.begin(), shapes.end());
+    shapes.clear();
+    for (Shape *sp : all) {
+        delete sp;
+    }
+}
+
+// The search getShapeAt makes without its index
+Shape *scan(const ShapeList & shapes, double x, double y) {
+    for (int i = shapes.size() - 1; i >= 0; i--) {
+        if (shapes[i]->contains(x, y)) return shapes[i];
+    }
+    return nullptr;
+}
+
+// Distinct points, so the hit cache never answers
+vector<GPoint> makePoints(int count, double side, mt19937 & rng) {
+    uniform_real_distribution<double> position(0, side);
+    vector<GPoint> points;
+    for (int i = 0; i < count; i++) {
+        points.push_back(GPoint(position(rng), position(rng)));
+    }
+    return points;
+}
+
+double microseconds(Clock::duration elapsed) {
+    return chrono::duration<double, micro>(elapsed).count();
+}
+
+// Answers that differ from the scan's, which should never happen
+int mismatches = 0;
+
+void staticScenes(int queries) {
+    printf("Static scenes\n");
+    printf("%8s %12s %12s %12s %12s\n", "shapes", "scan (us)", "build (us)",
+           "index (us)", "break-even");
+    for (int count = 64; count <= 65536; count *= 4) {
+        mt19937 rng(count);
+        ShapeList shapes;
+        fillScene(shapes, count, rng);
+        vector<GPoint> points = makePoints(queries, sideFor(count), rng);
+
+        vector<Shape *> expected;
+        expected.reserve(queries);
+        Clock::time_point start = Clock::now();
+        for (const GPoint & pt : points) {
+            expected.push_back(scan(shapes, pt.getX(), pt.getY()));
+        }
+        double scanCost = microseconds(Clock::now() - start) / queries;
+
+        ShapeIndex index;
+        start = Clock::now();
+        index.build(shapes);
+        double buildCost = microseconds(Clock::now() - start);
+
+        // The first queries scan until the rule builds the index
+        for (const GPoint & pt : makePoints(queries, sideFor(count), rng)) {
+            shapes.getShapeAt(pt.getX(), pt.getY());
+        }
+        vector<Shape *> found;
+        found.reserve(queries);
+        start = Clock::now();
+        for (const GPoint & pt : points) {
+            found.push_back(shapes.getShapeAt(pt.getX(), pt.getY()));
+        }
+        double pickCost = microseconds(Clock::now() - start) / queries;
+
+        if (scanCost > pickCost) {
+            printf("%8d %12.2f %12.1f %12.2f %12.1f\n", count, scanCost,
+                   buildCost, pickCost, buildCost / (scanCost - pickCost));
+        } else {
+            printf("%8d %12.2f %12.1f %12.2f %12s\n", count, scanCost,
+                   buildCost, pickCost, "never");
+        }
+        if (found != expected) mismatches++;
+        deleteScene(shapes);
+    }
+}
+
+void changingScenes(int queries) {
+    const int count = 16384;
+    printf("\nA shape moves every few queries, %d shapes\n", count);
+    printf("%8s %12s %12s\n", "every", "scan (us)", "getShapeAt (us)");
+    mt19937 rng(1);
+    ShapeList shapes;
+    fillScene(shapes, count, rng);
+    uniform_real_distribution<double> position(0, sideFor(count));
+    vector<GPoint> points = makePoints(queries, sideFor(count), rng);
+    for (int every = 1; every <= 256; every *= 4) {
+        Clock::duration scanTime(0);
+        Clock::duration pickTime(0);
+        for (int q = 0; q < queries; q++) {
+            if (q % every == 0) {
+                shapes[(int) (rng() % count)]->setLocation(position(rng),
+                                                          position(rng));
+            }
+            double x = points[q].getX();
+            double y = points[q].getY();
+            Clock::time_point start = Clock::now();
+            Shape *expected = scan(shapes, x, y);
+            Clock::time_point middle = Clock::now();
+            Shape *found = shapes.getShapeAt(x, y);
+            pickTime += Clock::now() - middle;
+            scanTime += middle - start;
+            if (found != expected) mismatches++;
+        }
+        printf("%8d %12.2f %12.2f\n", every, microseconds(scanTime) / queries,
+               microseconds(pickTime) / queries);
+    }
+    deleteScene(shapes);
+}
+
+}
+
+int main(int argc, char **argv) {
+    int queries = (argc > 1) ? atoi(argv[1]) : 2000;
+    staticScenes(queries);
+    changingScenes(queries);
+    if (mismatches > 0) {
+        printf("getShapeAt disagreed with the scan %d times\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * File: bench_shapequeue.cpp
+ * --------------------------
+ * This file is a standalone program that measures how fast producer
+ * threads can send shape commands to the thread that owns a ShapeList,
+ * through a ShapeCommandQueue and through the simple alternative: a
+ * Vector of pending commands guarded by a mutex, which the owner swaps
+ * out and applies in one update group per batch.
+ *
+ * Usage: bench_shapequeue [commands per producer]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "shapequeue.h"
+#include "vector.h"
+
+using namespace std;
+
+namespace {
+
+const int SHAPE_COUNT = 10000;
+const ColorId COLORS[] = {
+    resolveColor("RED"), resolveColor("GREEN"), resolveColor("BLUE")
+};
+
+// Vector has no move, so the owner flips between two buffers instead
+class LockedQueue {
+public:
+    LockedQueue() {
+        current = 0;
+    }
+
+    bool post(const ShapeCommand & command) {
+        lock_guard<mutex> guard(lock);
+        buffers[current].add(command);
+        return true;
+    }
+
+    int drain(ShapeList & shapes) {
+        Vector<ShapeCommand> *batch;
+        {
+            lock_guard<mutex> guard(lock);
+            batch = &buffers[current];
+            current = 1 - current;
+        }
+        shapes.beginUpdate();
+        for (const ShapeCommand & command : *batch) {
+            if (command.type == CMD_MOVE) {
+                command.shape->move(command.x, command.y);
+            } else {
+                command.shape->setColor(command.color);
+            }
+        }
+        shapes.endUpdate();
+        int applied = batch->size();
+        batch->clear();
+        return applied;
+    }
+
+private:
+    mutex lock;
+    Vector<ShapeCommand> buffers[2];
+    int current;                       // The buffer producers append to
+};
+
+// One command in sixteen is a color change, the rest are moves
+ShapeCommand makeCommand(const ShapeList & shapes, int producer, int i) {
+    Shape *sp = shapes[(producer * 7919 + i) % SHAPE_COUNT];
+    if (i % 16 == 0) {
+        return { CMD_SET_COLOR, sp, 0, 0, COLORS[i % 3] };
+    }
+    return { CMD_MOVE, sp, 0.001, -0.001, ColorId() };
+}
+
+/*
+ * Runs the producers against the owner thread and returns the number of
+ * commands applied per second, from the first post to the last apply.
+ */
+template <typename Queue>
+double run(Queue & queue, ShapeList & shapes, int producers, int perProducer) {
+    long long total = (long long) producers * perProducer;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, &shapes, p, perProducer] {
+            for (int i = 0; i < perProducer; i++) {
+                ShapeCommand command = makeCommand(shapes, p, i);
+                while (!queue.post(command)) {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+    long long applied = 0;
+    while (applied < total) {
+        int batch = queue.drain(shapes);
+        if (batch == 0) this_thread::yield();
+        applied += batch;
+    }
+    for (thread & t : threads) {
+        t.join();
+    }
+    chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+    return total / seconds.count();
+}
+
+}
+
+int main(int argc, char **argv) {
+    int perProducer = (argc > 1) ? atoi(argv[1]) : 1000000;
+    ShapeList shapes;
+    for (int i = 0; i < SHAPE_COUNT; i++) {
+        shapes.add(new Rect(i % 100 * 10, i / 100 * 10, 8, 8));
+    }
+    printf("%d commands per producer, %d shapes\n", perProducer, SHAPE_COUNT);
+    printf("%-10s %18s %18s\n", "producers", "queue (M/s)", "mutex (M/s)");
+    for (int producers = 1; producers <= 8; producers *= 2) {
+        ShapeCommandQueue queue;
+        LockedQueue locked;
+        double lockFree = run(queue, shapes, producers, perProducer);
+        double guarded = run(locked, shapes, producers, perProducer);
+        printf("%-10d %18.2f %18.2f\n", producers, lockFree / 1e6, guarded / 1e6);
+    }
+    vector<Shape *> all(shapes.begin(), shapes.end());
+    shapes.clear();
+    for (Shape *sp : all) {
+        delete sp;
+    }
+    return 0;
+}
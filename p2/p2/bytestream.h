@@ -0,0 +1,116 @@
+/*
+* File: bytestream.h
+* ------------------
+* This file defines the ByteWriter and ByteReader classes, which write
+* and read the little-endian binary encoding used to send shapes and
+* scene changes between processes.
+*/
+#ifndef _bytestream_h
+#define _bytestream_h
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+/*
+* Class: ByteWriter
+* -----------------
+* Appends fixed-width integers, doubles and length-prefixed strings to a
+* string used as a byte buffer. The byte order is little-endian on every
+* host, so buffers can be exchanged between machines.
+*/
+class ByteWriter {
+public:
+explicit ByteWriter(std::string & out) : out(out) {
+}
+void writeU8(uint8_t value) {
+out.push_back((char) value);
+}
+void writeU32(uint32_t value) {
+char bytes[4];
+for (int i = 0; i < 4; i++) {
+bytes[i] = (char) (value >> (8 * i));
+}
+out.append(bytes, 4);
+}
+void writeU64(uint64_t value) {
+char bytes[8];
+for (int i = 0; i < 8; i++) {
+bytes[i] = (char) (value >> (8 * i));
+}
+out.append(bytes, 8);
+}
+void writeDouble(double value) {
+uint64_t bits;
+std::memcpy(&bits, &value, sizeof bits);
+writeU64(bits);
+}
+void writeString(std::string_view str) {
+writeU32((uint32_t) str.size());
+out.append(str.data(), str.size());
+}
+private:
+std::string & out;
+};
+/*
+* Class: ByteReader
+* -----------------
+* Reads values written by ByteWriter from a buffer it does not own. Every
+* read checks the remaining length and throws a runtime_error if the
+* buffer ends too soon, so a truncated message is never read past its end.
+*/
+class ByteReader {
+public:
+ByteReader(const char *data, size_t size) : p(data), end(data + size) {
+}
+bool atEnd() const {
+return p == end;
+}
+size_t remaining() const {
+return end - p;
+}
+uint8_t readU8() {
+need(1);
+return (uint8_t) *p++;
+}
+uint32_t readU32() {
+need(4);
+uint32_t value = 0;
+for (int i = 0; i < 4; i++) {
+value |= (uint32_t) (uint8_t) p[i] << (8 * i);
+}
+p += 4;
+return value;
+}
+uint64_t readU64() {
+need(8);
+uint64_t value = 0;
+for (int i = 0; i < 8; i++) {
+value |= (uint64_t) (uint8_t) p[i] << (8 * i);
+}
+p += 8;
+return value;
+}
+double readDouble() {
+uint64_t bits = readU64();
+double value;
+std::memcpy(&value, &bits, sizeof value);
+return value;
+}
+std::string readString() {
+uint32_t size = readU32();
+need(size);
+std::string str(p, size);
+p += size;
+return str;
+}
+private:
+void need(size_t n) const {
+if ((size_t) (end - p) < n) {
+throw std::runtime_error("ByteReader: unexpected end of data");
+}
+}
+const char *p;
+const char *end;
+};
+#endif
@@ -0,0 +1,100 @@
+/*
+ * File: check_scenedelta.cpp
+ * --------------------------
+ * This file is a standalone program that sends a scene through a
+ * SceneEncoder into two in-process SceneReplica objects and checks, after
+ * every delta, that both accept it and match the encoder's list. It exits
+ * with a nonzero status if any check fails.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "bytestream.h"
+#include "scenedelta.h"
+
+using namespace std;
+
+namespace {
+
+int failures = 0;
+
+// Encodings are compared so that geometry, color and order are all checked
+bool sameShapes(const ShapeList & a, const ShapeList & b) {
+    if (a.size() != b.size()) return false;
+    for (int i = 0; i < a.size(); i++) {
+        string ea, eb;
+        ByteWriter wa(ea);
+        ByteWriter wb(eb);
+        a[i]->encode(wa);
+        b[i]->encode(wb);
+        if (ea != eb) return false;
+    }
+    return true;
+}
+
+void sendDelta(const char *step, SceneEncoder & encoder, const ShapeList & shapes,
+               SceneReplica & first, SceneReplica & second) {
+    string delta;
+    encoder.takeDelta(delta);
+    bool ok = first.apply(delta) && second.apply(delta)
+              && first.getChecksum() == encoder.getChecksum()
+              && second.getChecksum() == encoder.getChecksum()
+              && sameShapes(shapes, first.getShapes())
+              && sameShapes(shapes, second.getShapes());
+    printf("%-10s %6zu bytes  %s\n", step, delta.size(), ok ? "ok" : "FAILED");
+    if (!ok) failures++;
+}
+
+}
+
+int main() {
+    ShapeList shapes;
+    shapes.add(new Rect(0, 0, 10, 10));
+    shapes.add(new Oval(5, 5, 10, 20));
+    SceneEncoder encoder(shapes);
+    SceneReplica first, second;
+    sendDelta("initial", encoder, shapes, first, second);
+
+    double coords[] = { 0, 0, 10, 0, 5, 8 };
+    Polygon *triangle = new Polygon(coords, 3);
+    shapes.add(triangle);
+    ShapeGroup *group = new ShapeGroup();
+    group->add(new Line(1, 2, 3, 4));
+    group->add(new Square(7, 7, 3));
+    shapes.insert(1, group);
+    sendDelta("add", encoder, shapes, first, second);
+
+    for (int i = 0; i < 100; i++) {
+        shapes[0]->move(0.1, 0.3);
+    }
+    group->move(5, 5);
+    sendDelta("move", encoder, shapes, first, second);
+
+    shapes[2]->setColor("RED");
+    sendDelta("recolor", encoder, shapes, first, second);
+
+    triangle->addVertex(20, 20);
+    sendDelta("replace", encoder, shapes, first, second);
+
+    shapes.moveToBack(triangle);
+    shapes.moveForward(triangle);
+    shapes.moveToFront(shapes[0]);
+    sendDelta("reorder", encoder, shapes, first, second);
+
+    Shape *victim = shapes[1];
+    shapes.remove(1);
+    delete victim;
+    sendDelta("remove", encoder, shapes, first, second);
+
+    // The list does not own its shapes
+    vector<Shape *> remaining(shapes.begin(), shapes.end());
+    shapes.clear();
+    sendDelta("clear", encoder, shapes, first, second);
+    for (Shape *sp : remaining) {
+        delete sp;
+    }
+
+    printf("%s\n", failures == 0 ? "all checks passed" : "checks failed");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+/*
+ * File: check_vector.cpp
+ * ----------------------
+ * This file is a standalone program that checks Vector with an allocator
+ * that does not propagate on copy assignment and cannot be assigned,
+ * std::pmr::polymorphic_allocator. The explicit instantiation compiles
+ * every member against it, and main checks that copies draw from their
+ * own memory resource. It exits with a nonzero status if a check fails.
+ */
+
+#include <cstdio>
+#include <memory_resource>
+#include "vector.h"
+
+using namespace std;
+
+typedef pmr::polymorphic_allocator<int> IntAllocator;
+
+template class Vector<int, IntAllocator>;
+
+int main() {
+    pmr::monotonic_buffer_resource first, second;
+    Vector<int, IntAllocator> source{IntAllocator(&first)};
+    for (int i = 0; i < 100; i++) {
+        source.add(i);
+    }
+    Vector<int, IntAllocator> copy{IntAllocator(&second)};
+    copy.add(-1);
+    copy = source;
+    // A copy constructed from source uses the default resource instead
+    Vector<int, IntAllocator> constructed(source);
+    bool ok = copy.getAllocator().resource() == &second
+              && constructed.getAllocator().resource()
+                 == pmr::get_default_resource()
+              && copy.size() == 100 && constructed.size() == 100;
+    for (int i = 0; ok && i < 100; i++) {
+        ok = copy[i] == i && constructed[i] == i;
+    }
+    printf("%s\n", ok ? "all checks passed" : "checks failed");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+/*
+ * File: colortable.cpp
+ * --------------------
+ * This file implements the error-reporting color conversions declared in
+ * colortable.h.  The table itself is built at compile time in the header.
+ */
+
+#include "colortable.h"
+#include <string>
+
+using namespace std;
+
+extern void error(string msg);
+
+int convertColorToRGB(string_view colorName) {
+   ColorId id = resolveColor(colorName);
+   if (!id.isValid()) {
+      error("convertColorToRGB: Undefined color " + string(colorName));
+   }
+   return id.getRGB();
+}
+
+int convertColorToRGB(const char *colorName) {
+   return convertColorToRGB(string_view(colorName));
+}
@@ -0,0 +1,230 @@
+/*
+ * File: colortable.h
+ * ------------------
+ * This file exports a ColorId type and functions that resolve the color
+ * names accepted by GWindow::setColor without allocating.  The named
+ * colors are stored in a perfect hash table built at compile time.
+ */
+
+#ifndef _colortable_h
+#define _colortable_h
+
+#include <cstdint>
+#include <string_view>
+
+/*
+ * Class: ColorId
+ * --------------
+ * A resolved color.  A ColorId is a small value that holds the 0xRRGGBB
+ * encoding of a color, or an invalid marker if the name it was resolved
+ * from is not a color.  Equal colors have equal ids however they were
+ * spelled, so ids can be compared and stored in place of color strings.
+ */
+
+class ColorId {
+
+public:
+
+/*
+ * Constructor: ColorId
+ * Usage: ColorId none;
+ *        ColorId id(rgb);
+ * -----------------------
+ * Creates an invalid id, or the id of the color with the given 0xRRGGBB
+ * encoding.
+ */
+
+   constexpr ColorId() : value(-1) {
+   }
+
+   constexpr explicit ColorId(int rgb) : value(rgb & 0xFFFFFF) {
+   }
+
+/*
+ * Methods: isValid, getRGB
+ * Usage: if (id.isValid()) rgb = id.getRGB();
+ * -------------------------------------------
+ * Test whether the id names a color and return its 0xRRGGBB encoding.
+ */
+
+   constexpr bool isValid() const {
+      return value >= 0;
+   }
+
+   constexpr int getRGB() const {
+      return value;
+   }
+
+   constexpr bool operator==(ColorId other) const {
+      return value == other.value;
+   }
+
+   constexpr bool operator!=(ColorId other) const {
+      return value != other.value;
+   }
+
+private:
+
+   int32_t value;
+
+};
+
+/*
+ * Function: resolveColor
+ * Usage: ColorId id = resolveColor(name);
+ * ---------------------------------------
+ * Resolves a color name of the form accepted by GWindow::setColor, either
+ * one of the predefined names, ignoring case, spaces and underscores, or a
+ * string of the form "#rrggbb".  Returns an invalid ColorId if the name is
+ * not a color.  The function is constexpr, so constant names may be
+ * resolved at compile time.
+ */
+
+constexpr ColorId resolveColor(std::string_view name);
+
+/*
+ * Function: convertColorToRGB
+ * Usage: int rgb = convertColorToRGB(colorName);
+ * ----------------------------------------------
+ * Overloads of the gwindow.h function that resolve the name through the
+ * color table without copying it.  They call error if the name is not a
+ * color.
+ */
+
+int convertColorToRGB(std::string_view colorName);
+int convertColorToRGB(const char *colorName);
+
+/* Private section */
+
+/**********************************************************************/
+/* Note: Everything below this point in the file is logically part    */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+/*
+ * Implementation notes: perfect hash
+ * ----------------------------------
+ * Names are hashed with FNV-1a over their lowercase letters, skipping
+ * spaces and underscores, so every accepted spelling of a name has the
+ * same hash.  The seed is found at compile time by trying seeds until the
+ * predefined names land in distinct slots, which turns a lookup into one
+ * hash, one table read and one comparison.
+ */
+
+namespace colortable {
+
+struct NamedColor {
+   const char *name;
+   int rgb;
+};
+
+constexpr NamedColor NAMED_COLORS[] = {
+   { "black", 0x000000 },
+   { "blue", 0x0000FF },
+   { "cyan", 0x00FFFF },
+   { "darkgray", 0x595959 },
+   { "gray", 0x999999 },
+   { "green", 0x00FF00 },
+   { "lightgray", 0xBFBFBF },
+   { "magenta", 0xFF00FF },
+   { "orange", 0xFFC800 },
+   { "pink", 0xFFAFAF },
+   { "red", 0xFF0000 },
+   { "white", 0xFFFFFF },
+   { "yellow", 0xFFFF00 }
+};
+
+constexpr int NAMED_COLOR_COUNT = sizeof NAMED_COLORS / sizeof NAMED_COLORS[0];
+constexpr int TABLE_SIZE = 32;
+
+constexpr bool isSeparator(char ch) {
+   return ch == ' ' || ch == '_';
+}
+
+constexpr char toLower(char ch) {
+   return (ch >= 'A' && ch <= 'Z') ? char(ch - 'A' + 'a') : ch;
+}
+
+constexpr uint32_t hashName(std::string_view name, uint32_t seed) {
+   uint32_t hash = seed;
+   for (char ch : name) {
+      if (isSeparator(ch)) continue;
+      hash = (hash ^ (unsigned char) toLower(ch)) * 16777619u;
+   }
+   return hash;
+}
+
+constexpr int slotOf(uint32_t hash) {
+   return (int) ((hash >> 16) % TABLE_SIZE);
+}
+
+/* Compares name, ignoring case and separators, with a lowercase name */
+constexpr bool matchesName(std::string_view name, const char *canonical) {
+   int k = 0;
+   for (char ch : name) {
+      if (isSeparator(ch)) continue;
+      if (canonical[k] == '\0' || toLower(ch) != canonical[k]) return false;
+      k++;
+   }
+   return canonical[k] == '\0';
+}
+
+constexpr uint32_t findSeed() {
+   for (uint32_t seed = 2166136261u; ; seed++) {
+      bool used[TABLE_SIZE] = { };
+      bool ok = true;
+      for (int i = 0; i < NAMED_COLOR_COUNT && ok; i++) {
+         int slot = slotOf(hashName(NAMED_COLORS[i].name, seed));
+         ok = !used[slot];
+         used[slot] = true;
+      }
+      if (ok) return seed;
+   }
+}
+
+constexpr uint32_t SEED = findSeed();
+
+struct Table {
+   int index[TABLE_SIZE];
+
+   constexpr Table() : index() {
+      for (int k = 0; k < TABLE_SIZE; k++) {
+         index[k] = -1;
+      }
+      for (int i = 0; i < NAMED_COLOR_COUNT; i++) {
+         index[slotOf(hashName(NAMED_COLORS[i].name, SEED))] = i;
+      }
+   }
+};
+
+constexpr Table TABLE;
+
+constexpr int hexDigit(char ch) {
+   if (ch >= '0' && ch <= '9') return ch - '0';
+   if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+   if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+   return -1;
+}
+
+}
+
+constexpr ColorId resolveColor(std::string_view name) {
+   if (!name.empty() && name[0] == '#') {
+      if (name.size() != 7) return ColorId();
+      int rgb = 0;
+      for (int i = 1; i < 7; i++) {
+         int digit = colortable::hexDigit(name[i]);
+         if (digit < 0) return ColorId();
+         rgb = (rgb << 4) | digit;
+      }
+      return ColorId(rgb);
+   }
+   uint32_t hash = colortable::hashName(name, colortable::SEED);
+   int i = colortable::TABLE.index[colortable::slotOf(hash)];
+   if (i < 0) return ColorId();
+   const colortable::NamedColor & entry = colortable::NAMED_COLORS[i];
+   if (!colortable::matchesName(name, entry.name)) return ColorId();
+   return ColorId(entry.rgb);
+}
+
+#endif
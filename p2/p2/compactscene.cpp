@@ -0,0 +1,259 @@
+/*
+ * File: compactscene.cpp
+ * ----------------------
+ * This file implements the CompactScene class.
+ */
+
+#include "compactscene.h"
+#include "bytestream.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const double ONE = 65536;                    // 1.0 in 16.16 fixed point
+const double MAX_COORDINATE = 1e12;          // Keeps tiles in 32 bits
+
+int64_t toFixed(double value) {
+    return llround(value * ONE);
+}
+
+}
+
+CompactScene::CompactScene() {
+    /* Empty */
+}
+
+/*
+ * Implementation notes: add
+ * -------------------------
+ * The fields are read back from the shape's encoding, which every shape
+ * class already provides, rather than through accessors added for this
+ * purpose. Every check is made before anything is stored, so a rejected
+ * shape leaves the scene unchanged.
+ */
+
+bool CompactScene::add(const Shape *sp) {
+    string encoding;
+    ByteWriter out(encoding);
+    sp->encode(out);
+    ByteReader in(encoding.data(), encoding.size());
+    int type = in.readU8();
+    if (type != SHAPE_LINE && type != SHAPE_SQUARE
+                           && type != SHAPE_RECT && type != SHAPE_OVAL) {
+        return false;
+    }
+    double x = in.readDouble();
+    double y = in.readDouble();
+    string color = in.readString();
+    double w = in.readDouble();
+    double h = (type == SHAPE_SQUARE) ? w : in.readDouble();
+    if (!(fabs(x) < MAX_COORDINATE && fabs(y) < MAX_COORDINATE
+          && fabs(w) < MAX_COORDINATE && fabs(h) < MAX_COORDINATE)) {
+        return false;
+    }
+    // Extents are checked once rounded, since values just below 32768
+    // round up to 2^31
+    int64_t fixedW = toFixed(w);
+    int64_t fixedH = toFixed(h);
+    if (fixedW < INT32_MIN || fixedW > INT32_MAX
+                           || fixedH < INT32_MIN || fixedH > INT32_MAX) {
+        return false;
+    }
+    auto found = paletteIndex.find(color);
+    int colorIndex;
+    if (found != paletteIndex.end()) {
+        colorIndex = found->second;
+    } else {
+        if (palette.size() > UINT16_MAX) return false;
+        colorIndex = (int) palette.size();
+        paletteIndex.emplace(color, colorIndex);
+        paletteIds.push_back(sp->getColorId());
+        palette.push_back(std::move(color));
+    }
+    int tile = tileFor(x, y);
+    types.push_back((uint8_t) type);
+    tiles.push_back((uint32_t) tile);
+    xs.push_back((int32_t) toFixed(x - (double) tileX[tile] * TILE_SIZE));
+    ys.push_back((int32_t) toFixed(y - (double) tileY[tile] * TILE_SIZE));
+    ws.push_back((int32_t) fixedW);
+    hs.push_back((int32_t) fixedH);
+    colors.push_back((uint16_t) colorIndex);
+    return true;
+}
+
+int CompactScene::size() const {
+    return (int) types.size();
+}
+
+bool CompactScene::isEmpty() const {
+    return types.empty();
+}
+
+void CompactScene::clear() {
+    types.clear();
+    tiles.clear();
+    xs.clear();
+    ys.clear();
+    ws.clear();
+    hs.clear();
+    colors.clear();
+    tileX.clear();
+    tileY.clear();
+    tileIndex.clear();
+    palette.clear();
+    paletteIds.clear();
+    paletteIndex.clear();
+}
+
+Shape *CompactScene::toShape(int index) const {
+    if (index < 0 || index >= size()) {
+        throw runtime_error("toShape: index out of range");
+    }
+    uint32_t tile = tiles[index];
+    double x = (double) tileX[tile] * TILE_SIZE + xs[index] / ONE;
+    double y = (double) tileY[tile] * TILE_SIZE + ys[index] / ONE;
+    double w = ws[index] / ONE;
+    double h = hs[index] / ONE;
+    Shape *sp;
+    switch (types[index]) {
+    case SHAPE_LINE: sp = new Line(x, y, x + w, y + h); break;
+    case SHAPE_SQUARE: sp = new Square(x, y, w); break;
+    case SHAPE_RECT: sp = new Rect(x, y, w, h); break;
+    default: sp = new Oval(x, y, w, h); break;
+    }
+    sp->setColor(palette[colors[index]]);
+    return sp;
+}
+
+void CompactScene::draw(RenderTarget & target) const {
+    int current = -1;
+    for (int i = 0; i < size(); i++) {
+        if (colors[i] != current) {
+            current = colors[i];
+            target.setColor(paletteIds[current]);
+        }
+        double x = (double) tileX[tiles[i]] * TILE_SIZE + xs[i] / ONE;
+        double y = (double) tileY[tiles[i]] * TILE_SIZE + ys[i] / ONE;
+        double w = ws[i] / ONE;
+        double h = hs[i] / ONE;
+        switch (types[i]) {
+        case SHAPE_LINE: target.drawLine(x, y, x + w, y + h); break;
+        case SHAPE_OVAL: target.fillOval(x, y, w, h); break;
+        default: target.fillRect(x, y, w, h); break;
+        }
+    }
+}
+
+void CompactScene::draw(GWindow & gw) const {
+    WindowTarget target(gw);
+    draw(target);
+}
+
+/*
+ * Implementation notes: getShapeAt
+ * --------------------------------
+ * The point is converted to fixed point once, and then into the tile of
+ * each shape by subtracting integers, so every shape is tested against
+ * exactly the same point. Rectangles are tested entirely in integers; the
+ * oval and line tests need products too large for 32 bits and use
+ * doubles, whose rounding there is far below one fixed-point unit.
+ */
+
+int CompactScene::getShapeAt(double x, double y) const {
+    int64_t qx = toFixed(x);
+    int64_t qy = toFixed(y);
+    int64_t tileFixed = (int64_t) TILE_SIZE << FRACTION_BITS;
+    for (int i = size() - 1; i >= 0; i--) {
+        int64_t rx = qx - tileX[tiles[i]] * tileFixed - xs[i];
+        int64_t ry = qy - tileY[tiles[i]] * tileFixed - ys[i];
+        int64_t w = ws[i];
+        int64_t h = hs[i];
+        switch (types[i]) {
+        case SHAPE_SQUARE: case SHAPE_RECT:
+            if (rx >= 0 && rx <= w && ry >= 0 && ry <= h) return i;
+            break;
+        case SHAPE_OVAL:
+            if (w > 0 && h > 0) {
+                double ex = (2 * rx - w) / (double) w;
+                double ey = (2 * ry - h) / (double) h;
+                if (ex * ex + ey * ey <= 1) return i;
+            }
+            break;
+        case SHAPE_LINE: {
+            double dx = (double) w;
+            double dy = (double) h;
+            double norm = dx * dx + dy * dy;
+            double u = (norm == 0) ? 0 : (rx * dx + ry * dy) / norm;
+            u = max(0.0, min(1.0, u));
+            double ex = u * dx - rx;
+            double ey = u * dy - ry;
+            if (ex * ex + ey * ey <= 0.25 * ONE * ONE) return i;
+            break;
+        }
+        }
+    }
+    return -1;
+}
+
+void CompactScene::query(double left, double top, double right, double bottom,
+                         vector<int> & indices) const {
+    int64_t ql = toFixed(left);
+    int64_t qt = toFixed(top);
+    int64_t qr = toFixed(right);
+    int64_t qb = toFixed(bottom);
+    int64_t tileFixed = (int64_t) TILE_SIZE << FRACTION_BITS;
+    int64_t half = (int64_t) ONE / 2;
+    for (int i = 0; i < size(); i++) {
+        int64_t ox = tileX[tiles[i]] * tileFixed + xs[i];
+        int64_t oy = tileY[tiles[i]] * tileFixed + ys[i];
+        int64_t x0 = ox, x1 = ox + ws[i];
+        int64_t y0 = oy, y1 = oy + hs[i];
+        if (types[i] == SHAPE_LINE) {
+            // Lines run either way and are half a pixel wide on each side
+            if (x1 < x0) swap(x0, x1);
+            if (y1 < y0) swap(y0, y1);
+            x0 -= half;
+            y0 -= half;
+            x1 += half;
+            y1 += half;
+        }
+        if (x0 <= qr && x1 >= ql && y0 <= qb && y1 >= qt) {
+            indices.push_back(i);
+        }
+    }
+}
+
+size_t CompactScene::getMemoryUsage() const {
+    size_t bytes = types.capacity() * sizeof(uint8_t)
+                 + tiles.capacity() * sizeof(uint32_t)
+                 + (xs.capacity() + ys.capacity() + ws.capacity()
+                    + hs.capacity()) * sizeof(int32_t)
+                 + colors.capacity() * sizeof(uint16_t)
+                 + (tileX.capacity() + tileY.capacity()) * sizeof(int32_t)
+                 + paletteIds.capacity() * sizeof(ColorId);
+    for (const string & name : palette) {
+        bytes += sizeof(string) + name.capacity();
+    }
+    // Each map entry is a separately allocated node chained from a bucket
+    bytes += tileIndex.bucket_count() * sizeof(void *)
+           + tileIndex.size() * (sizeof(pair<int64_t, int>) + sizeof(void *));
+    bytes += paletteIndex.bucket_count() * sizeof(void *)
+           + paletteIndex.size() * (sizeof(pair<string, int>) + sizeof(void *));
+    return bytes;
+}
+
+int CompactScene::tileFor(double x, double y) {
+    int32_t tx = (int32_t) floor(x / TILE_SIZE);
+    int32_t ty = (int32_t) floor(y / TILE_SIZE);
+    int64_t key = ((int64_t) tx << 32) | (uint32_t) ty;
+    auto result = tileIndex.emplace(key, (int) tileX.size());
+    if (result.second) {
+        tileX.push_back(tx);
+        tileY.push_back(ty);
+    }
+    return result.first->second;
+}
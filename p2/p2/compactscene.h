@@ -0,0 +1,127 @@
+/*
+* File: compactscene.h
+* --------------------
+* This file defines a CompactScene class that stores large numbers of
+* simple shapes in a fraction of the memory a ShapeList of Shape objects
+* needs.
+*/
+#ifndef _compactscene_h
+#define _compactscene_h
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "gwindow.h"
+#include "rendertarget.h"
+#include "shape.h"
+/*
+* Class: CompactScene
+* -------------------
+* Holds copies of lines, squares, rectangles and ovals as columns of
+* 16.16 fixed-point numbers instead of as objects. The plane is divided
+* into square tiles TILE_SIZE pixels wide, and every shape stores its
+* location relative to the origin of the tile containing it, so precision
+* does not fall off far from the origin of the plane.
+*
+* Precision: every location and extent is rounded to the nearest 1/65536
+* of a pixel, so it is within 1/131072 of a pixel of the original value,
+* wherever in the plane the shape lies. Extents (widths, heights, and the
+* offsets from the start to the end of a line) must round to at least
+* -32768 and less than 32768 pixels. Containment and culling are exact
+* with respect to the stored values, so their answers can differ from
+* those of the original shapes only for points within that rounding error
+* of an edge.
+*
+* A shape takes 23 bytes: a type byte, four 32-bit coordinates, a 32-bit
+* tile number and a 16-bit index into a palette of up to 65536 colors.
+* On a 64-bit system a Rect object takes 88 bytes, before counting the
+* pointer to it and the overhead of allocating it.
+*/
+class CompactScene {
+public:
+static const int TILE_SIZE = 8192;
+CompactScene();
+/*
+* Method: add
+* Usage: if (!scene.add(sp)) ...
+* -------------------------------
+* Appends a compact copy of sp in front of the shapes already in the
+* scene and returns true. Returns false, adding nothing, if sp is not a
+* line, square, rectangle or oval, if an extent is too large, or if the
+* palette is full.
+*/
+bool add(const Shape *sp);
+int size() const;
+bool isEmpty() const;
+void clear();
+/*
+* Method: toShape
+* Usage: Shape *sp = scene.toShape(index);
+* ----------------------------------------
+* Returns a newly allocated Shape equal to the stored shape at index,
+* which the caller must delete.
+*/
+Shape *toShape(int index) const;
+/*
+* Method: draw
+* Usage: scene.draw(target);
+* scene.draw(gw);
+* ----------------
+* Draws the shapes from back to front on a render target or the graphics
+* window, as ShapeList does.
+*/
+void draw(RenderTarget & target) const;
+void draw(GWindow & gw) const;
+/*
+* Method: getShapeAt
+* Usage: int index = scene.getShapeAt(x, y);
+* ------------------------------------------
+* Returns the index of a shape containing (x, y), choosing as ShapeList
+* does, or -1 if there is none.
+*/
+int getShapeAt(double x, double y) const;
+/*
+* Method: query
+* Usage: scene.query(left, top, right, bottom, indices);
+* ------------------------------------------------------
+* Appends to indices, in drawing order, the index of every shape whose
+* bounds intersect the given rectangle.
+*/
+void query(double left, double top, double right, double bottom,
+std::vector<int> & indices) const;
+/*
+* Method: getMemoryUsage
+* Usage: size_t bytes = scene.getMemoryUsage();
+* ---------------------------------------------
+* Returns the number of bytes allocated for the shapes, tiles and palette.
+*/
+size_t getMemoryUsage() const;
+private:
+/*
+* Implementation notes: CompactScene
+* ----------------------------------
+* The fields of the shapes are kept in separate arrays of 32-bit values,
+* so getShapeAt and query stream through only the columns they need, and
+* read half the bytes per shape that doubles would take. The tests widen
+* each field to 64 bits, because a point anywhere in the plane does not
+* fit in 32 bits until it has been moved into the tile of a shape, and
+* they branch on the type of each shape, so they run one shape at a time
+* rather than in vector lanes. For a line, w and h hold the signed offset
+* to its end point. A point is converted into the tile of each shape with
+* integer arithmetic, so a test involves no rounding beyond that of the
+* query point itself.
+*/
+static const int FRACTION_BITS = 16;
+int tileFor(double x, double y);
+std::vector<uint8_t> types;
+std::vector<uint32_t> tiles;
+std::vector<int32_t> xs, ys, ws, hs;
+std::vector<uint16_t> colors;
+std::vector<int32_t> tileX, tileY;     // Tile coordinates, in tiles
+std::unordered_map<int64_t, int> tileIndex;
+std::vector<std::string> palette;
+std::vector<ColorId> paletteIds;
+std::unordered_map<std::string, int> paletteIndex;
+};
+#endif
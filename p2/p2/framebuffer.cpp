@@ -0,0 +1,479 @@
+#include "framebuffer.h"
+#include "gwindow.h"
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Implementation notes: Framebuffer class
+//
+// Pixel (i, j) covers the square [i, i + 1) x [j, j + 1).  Coverage is
+// converted to an alpha in the range 0..256 so that blending reduces to
+// an integer multiply and a shift.  The red and blue channels of a pixel
+// are blended together in one 32-bit multiply, since their products
+// cannot overlap, and green is blended separately.
+
+namespace {
+
+inline int toAlpha(double coverage) {
+    if (coverage <= 0) return 0;
+    if (coverage >= 1) return 256;
+    return (int) (coverage * 256 + 0.5);
+}
+
+inline uint32_t blend(uint32_t dst, uint32_t src, int alpha) {
+    uint32_t inv = 256 - alpha;
+    uint32_t rb = ((src & 0xFF00FF) * alpha + (dst & 0xFF00FF) * inv) >> 8;
+    uint32_t g = ((src & 0x00FF00) * alpha + (dst & 0x00FF00) * inv) >> 8;
+    return (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+// Returns the length of the overlap of [i, i + 1) with [left, right)
+inline double overlap(int i, double left, double right) {
+    double lo = max((double) i, left);
+    double hi = min((double) i + 1, right);
+    return (hi > lo) ? hi - lo : 0;
+}
+
+const int SUBSCANLINES = 4;
+
+}
+
+Framebuffer::Framebuffer(int width, int height) {
+    this->width = max(0, width);
+    this->height = max(0, height);
+    pixels.assign((size_t) this->width * this->height, 0xFFFFFF);
+    originX = originY = 0;
+    color = 0x000000;
+    antialiasing = true;
+    idMode = false;
+}
+
+int Framebuffer::getWidth() const {
+    return width;
+}
+
+int Framebuffer::getHeight() const {
+    return height;
+}
+
+void Framebuffer::clear(int rgb) {
+    std::fill(pixels.begin(), pixels.end(), (uint32_t) rgb & 0xFFFFFF);
+}
+
+void Framebuffer::setAntialiasing(bool flag) {
+    antialiasing = flag;
+}
+
+bool Framebuffer::isAntialiasing() const {
+    return antialiasing;
+}
+
+void Framebuffer::setIdMode(bool flag) {
+    idMode = flag;
+    color = 0;
+}
+
+bool Framebuffer::isIdMode() const {
+    return idMode;
+}
+
+void Framebuffer::setId(uint32_t id) {
+    if (idMode) color = id;
+}
+
+void Framebuffer::setOrigin(int x, int y) {
+    originX = x;
+    originY = y;
+}
+
+int Framebuffer::getOriginX() const {
+    return originX;
+}
+
+int Framebuffer::getOriginY() const {
+    return originY;
+}
+
+GRectangle Framebuffer::getViewport() const {
+    return GRectangle(originX, originY, width, height);
+}
+
+void Framebuffer::setColor(string_view color) {
+    setColor(resolveColor(color));
+}
+
+void Framebuffer::setColor(int rgb) {
+    if (!idMode) color = (uint32_t) rgb & 0xFFFFFF;
+}
+
+void Framebuffer::setColor(ColorId color) {
+    if (!color.isValid()) throw runtime_error("Framebuffer::setColor: Undefined color");
+    if (!idMode) this->color = (uint32_t) color.getRGB();
+}
+
+int Framebuffer::getPixel(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) return 0;
+    return pixels[(size_t) y * width + x];
+}
+
+const uint32_t *Framebuffer::getPixels() const {
+    return pixels.data();
+}
+
+uint32_t *Framebuffer::getPixels() {
+    return pixels.data();
+}
+
+/*
+ * Implementation notes: drawLine
+ * ------------------------------
+ * The antialiased path is Wu's algorithm.  The coordinates are shifted by
+ * half a pixel so that pixel centers fall on integers, after which each
+ * column of an x-major line (or row of a y-major one) receives two pixels
+ * whose intensities sum to one.  The aliased path is a plain DDA.  Both
+ * paths first clip the line to the framebuffer, widened by two pixels so
+ * that the clipped ends stay out of sight, which keeps the cost of a long
+ * line proportional to its visible length.
+ */
+
+void Framebuffer::drawLine(double x0, double y0, double x1, double y1) {
+    x0 -= originX;
+    y0 -= originY;
+    x1 -= originX;
+    y1 -= originY;
+    if (!clipLine(x0, y0, x1, y1)) return;
+    if (!antialiasing || idMode) {
+        double dx = x1 - x0;
+        double dy = y1 - y0;
+        int steps = (int) ceil(max(fabs(dx), fabs(dy)));
+        if (steps == 0) {
+            plot((int) floor(x0), (int) floor(y0), 1);
+            return;
+        }
+        for (int k = 0; k <= steps; k++) {
+            plot((int) floor(x0 + dx * k / steps),
+                 (int) floor(y0 + dy * k / steps), 1);
+        }
+        return;
+    }
+    x0 -= 0.5;
+    y0 -= 0.5;
+    x1 -= 0.5;
+    y1 -= 0.5;
+    bool steep = fabs(y1 - y0) > fabs(x1 - x0);
+    if (steep) {
+        swap(x0, y0);
+        swap(x1, y1);
+    }
+    if (x0 > x1) {
+        swap(x0, x1);
+        swap(y0, y1);
+    }
+    double dx = x1 - x0;
+    double gradient = (dx == 0) ? 0 : (y1 - y0) / dx;
+    auto put = [this, steep](int u, int v, double coverage) {
+        if (steep) {
+            plot(v, u, coverage);
+        } else {
+            plot(u, v, coverage);
+        }
+    };
+
+    double xend = floor(x0 + 0.5);
+    double yend = y0 + gradient * (xend - x0);
+    double xgap = 1 - (x0 + 0.5 - floor(x0 + 0.5));
+    int xstart = (int) xend;
+    double frac = yend - floor(yend);
+    put(xstart, (int) floor(yend), (1 - frac) * xgap);
+    put(xstart, (int) floor(yend) + 1, frac * xgap);
+    double intery = yend + gradient;
+
+    xend = floor(x1 + 0.5);
+    yend = y1 + gradient * (xend - x1);
+    xgap = x1 + 0.5 - floor(x1 + 0.5);
+    int xstop = (int) xend;
+    if (xstop != xstart) {
+        frac = yend - floor(yend);
+        put(xstop, (int) floor(yend), (1 - frac) * xgap);
+        put(xstop, (int) floor(yend) + 1, frac * xgap);
+    }
+
+    for (int u = xstart + 1; u < xstop; u++) {
+        int v = (int) floor(intery);
+        frac = intery - v;
+        put(u, v, 1 - frac);
+        put(u, v + 1, frac);
+        intery += gradient;
+    }
+}
+
+// Liang-Barsky clipping against the framebuffer plus a two-pixel margin
+bool Framebuffer::clipLine(double & x0, double & y0,
+                           double & x1, double & y1) const {
+    const double MARGIN = 2;
+    double dx = x1 - x0;
+    double dy = y1 - y0;
+    double p[4] = { -dx, dx, -dy, dy };
+    double q[4] = { x0 + MARGIN, width + MARGIN - x0,
+                    y0 + MARGIN, height + MARGIN - y0 };
+    double t0 = 0, t1 = 1;
+    for (int k = 0; k < 4; k++) {
+        if (p[k] == 0) {
+            if (q[k] < 0) return false;
+        } else {
+            double t = q[k] / p[k];
+            if (p[k] < 0) {
+                t0 = max(t0, t);
+            } else {
+                t1 = min(t1, t);
+            }
+        }
+    }
+    if (t0 > t1) return false;
+    if (t1 < 1) {
+        x1 = x0 + t1 * dx;
+        y1 = y0 + t1 * dy;
+    }
+    if (t0 > 0) {
+        x0 += t0 * dx;
+        y0 += t0 * dy;
+    }
+    return true;
+}
+
+void Framebuffer::fillRect(double x, double y, double width, double height) {
+    if (width <= 0 || height <= 0) return;
+    x -= originX;
+    y -= originY;
+    double right = x + width;
+    double bottom = y + height;
+    if (!antialiasing || idMode) {
+        int i0 = (int) ceil(x - 0.5);
+        int i1 = (int) ceil(right - 0.5);
+        int j0 = max(0, (int) ceil(y - 0.5));
+        int j1 = min(this->height, (int) ceil(bottom - 0.5));
+        for (int j = j0; j < j1; j++) {
+            blendSpan(i0, j, i1 - i0, 256);
+        }
+        return;
+    }
+    int j0 = max(0, (int) floor(y));
+    int j1 = min(this->height, (int) ceil(bottom));
+    int il = (int) floor(x);
+    int ir = (int) floor(right);
+    for (int j = j0; j < j1; j++) {
+        double weight = overlap(j, y, bottom);
+        if (il == ir) {
+            plot(il, j, (right - x) * weight);
+            continue;
+        }
+        int alpha = toAlpha(weight);
+        plot(il, j, (il + 1 - x) * weight);
+        blendSpan(il + 1, j, ir - il - 1, alpha);
+        if (right > ir) plot(ir, j, (right - ir) * weight);
+    }
+}
+
+/*
+ * Implementation notes: fillOval
+ * ------------------------------
+ * Each pixel row is split into four sub-scanlines, and the chord of the
+ * ellipse on each one is computed exactly.  Pixels inside all four chords
+ * are fully covered and are filled as one span.  The pixels between the
+ * innermost and outermost chord ends are blended with the average of
+ * their exact horizontal overlap with each chord.
+ */
+
+void Framebuffer::fillOval(double x, double y, double width, double height) {
+    if (width <= 0 || height <= 0) return;
+    x -= originX;
+    y -= originY;
+    double rx = width / 2;
+    double ry = height / 2;
+    double cx = x + rx;
+    double cy = y + ry;
+    if (!antialiasing || idMode) {
+        int j0 = max(0, (int) ceil(y - 0.5));
+        int j1 = min(this->height, (int) ceil(y + height - 0.5));
+        for (int j = j0; j < j1; j++) {
+            double t = (j + 0.5 - cy) / ry;
+            if (fabs(t) >= 1) continue;
+            double half = rx * sqrt(1 - t * t);
+            int i0 = (int) ceil(cx - half - 0.5);
+            int i1 = (int) ceil(cx + half - 0.5);
+            blendSpan(i0, j, i1 - i0, 256);
+        }
+        return;
+    }
+    int j0 = max(0, (int) floor(y));
+    int j1 = min(this->height, (int) ceil(y + height));
+    double left[SUBSCANLINES];
+    double right[SUBSCANLINES];
+    for (int j = j0; j < j1; j++) {
+        double outerL = cx, outerR = cx;
+        double innerL = x, innerR = x + width;
+        bool solid = true;
+        for (int s = 0; s < SUBSCANLINES; s++) {
+            double t = (j + (s + 0.5) / SUBSCANLINES - cy) / ry;
+            if (fabs(t) >= 1) {
+                left[s] = right[s] = cx;
+                solid = false;
+                continue;
+            }
+            double half = rx * sqrt(1 - t * t);
+            left[s] = cx - half;
+            right[s] = cx + half;
+            outerL = min(outerL, left[s]);
+            outerR = max(outerR, right[s]);
+            innerL = max(innerL, left[s]);
+            innerR = min(innerR, right[s]);
+        }
+        if (outerR <= outerL) continue;
+        int a0 = max(0, (int) floor(outerL));
+        int a1 = min(this->width, (int) ceil(outerR));
+        int f0 = a1, f1 = a1;
+        if (solid && ceil(innerL) < floor(innerR)) {
+            f0 = max(a0, min(a1, (int) ceil(innerL)));
+            f1 = max(f0, min(a1, (int) floor(innerR)));
+        }
+        for (int i = a0; i < a1; i++) {
+            if (i == f0) {
+                blendSpan(f0, j, f1 - f0, 256);
+                i = f1;
+                if (i >= a1) break;
+            }
+            double coverage = 0;
+            for (int s = 0; s < SUBSCANLINES; s++) {
+                coverage += overlap(i, left[s], right[s]);
+            }
+            plot(i, j, coverage / SUBSCANLINES);
+        }
+    }
+}
+
+/*
+ * Implementation notes: fillPolygon
+ * ---------------------------------
+ * The antialiased path accumulates coverage for one row at a time.  The
+ * partial pixels at the ends of each sub-scanline span are added to the
+ * rowCoverage array directly, while the fully covered pixels between them
+ * are recorded as a step in rowRuns.  A prefix sum over rowRuns then
+ * adds the interior contributions, so the work per span is constant and
+ * the pixels that end up fully covered are filled as one span.
+ */
+
+void Framebuffer::fillPolygon(const double *coords, int count,
+                              double x, double y, FillRule rule) {
+    if (count < 3) return;
+    EdgeTable table(coords, count, x - originX, y - originY);
+    int j0 = max(0, (int) floor(table.getTop()));
+    int j1 = min(height, (int) ceil(table.getBottom()));
+    if (!antialiasing || idMode) {
+        for (int j = j0; j < j1; j++) {
+            table.scan(j + 0.5, rule, [this, j](double left, double right) {
+                int i0 = (int) ceil(left - 0.5);
+                int i1 = (int) ceil(right - 0.5);
+                blendSpan(i0, j, i1 - i0, 256);
+            });
+        }
+        return;
+    }
+    rowCoverage.assign(width + 1, 0);
+    rowRuns.assign(width + 1, 0);
+    const float weight = 1.0f / SUBSCANLINES;
+    for (int j = j0; j < j1; j++) {
+        int lo = width, hi = 0;
+        for (int s = 0; s < SUBSCANLINES; s++) {
+            double sy = j + (s + 0.5) / SUBSCANLINES;
+            table.scan(sy, rule, [&](double left, double right) {
+                left = max(left, 0.0);
+                right = min(right, (double) width);
+                if (left >= right) return;
+                int il = (int) floor(left);
+                int ir = (int) floor(right);
+                lo = min(lo, il);
+                hi = max(hi, ir + 1);
+                if (il == ir) {
+                    rowCoverage[il] += (float) (right - left) * weight;
+                    return;
+                }
+                rowCoverage[il] += (float) (il + 1 - left) * weight;
+                rowRuns[il + 1] += weight;
+                rowRuns[ir] -= weight;
+                rowCoverage[ir] += (float) (right - ir) * weight;
+            });
+        }
+        hi = min(hi, width);
+        float step = 0;
+        int solid = -1;
+        for (int i = lo; i <= hi; i++) {
+            step += rowRuns[i];
+            float c = (i < hi) ? rowCoverage[i] + step : 0;
+            rowRuns[i] = rowCoverage[i] = 0;
+            if (c >= 1 - 1e-6f) {
+                if (solid < 0) solid = i;
+                continue;
+            }
+            if (solid >= 0) {
+                blendSpan(solid, j, i - solid, 256);
+                solid = -1;
+            }
+            if (c > 0) plot(i, j, c);
+        }
+    }
+}
+
+void Framebuffer::plot(int x, int y, double coverage) {
+    if (x < 0 || x >= width || y < 0 || y >= height) return;
+    int alpha = toAlpha(coverage);
+    if (alpha == 0) return;
+    uint32_t & dst = pixels[(size_t) y * width + x];
+    dst = (alpha == 256) ? color : blend(dst, color, alpha);
+}
+
+/*
+ * Implementation notes: blendSpan
+ * -------------------------------
+ * Spans are the bulk of the fill work, so a fully opaque span is a plain
+ * fill and a translucent one is blended four pixels at a time with SSE2
+ * where available.  The source color is premultiplied by alpha once per
+ * span.  The scalar loop handles the remainder and other targets.
+ */
+
+void Framebuffer::blendSpan(int x, int y, int length, int alpha) {
+    if (y < 0 || y >= height || alpha <= 0) return;
+    int start = max(0, x);
+    int stop = min(width, x + length);
+    if (start >= stop) return;
+    uint32_t *p = pixels.data() + (size_t) y * width + start;
+    uint32_t *end = pixels.data() + (size_t) y * width + stop;
+    if (alpha >= 256) {
+        std::fill(p, end, color);
+        return;
+    }
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i src = _mm_unpacklo_epi8(_mm_set1_epi32((int) color), zero);
+    __m128i premul = _mm_mullo_epi16(src, _mm_set1_epi16((short) alpha));
+    __m128i inv = _mm_set1_epi16((short) (256 - alpha));
+    for (; end - p >= 4; p += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i *) p);
+        __m128i lo = _mm_unpacklo_epi8(d, zero);
+        __m128i hi = _mm_unpackhi_epi8(d, zero);
+        lo = _mm_srli_epi16(_mm_add_epi16(premul, _mm_mullo_epi16(lo, inv)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(premul, _mm_mullo_epi16(hi, inv)), 8);
+        __m128i out = _mm_and_si128(_mm_packus_epi16(lo, hi),
+                                    _mm_set1_epi32(0xFFFFFF));
+        _mm_storeu_si128((__m128i *) p, out);
+    }
+#endif
+    for (; p < end; p++) {
+        *p = blend(*p, color, alpha);
+    }
+}
@@ -0,0 +1,153 @@
+/*
+* File: framebuffer.h
+* -------------------
+* This file defines a Framebuffer class that rasterizes the GWindow
+* drawing calls into an in-memory pixel buffer, for rendering scenes
+* without a window.
+*/
+#ifndef _framebuffer_h
+#define _framebuffer_h
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "colortable.h"
+#include "gtypes.h"
+#include "rendertarget.h"
+#include "scanline.h"
+/*
+* Class: Framebuffer
+* ------------------
+* A headless RenderTarget whose drawLine, fillRect, fillOval and setColor
+* methods mirror those of GWindow. Pixels are stored row by row
+* as 0xRRGGBB values. When antialiasing is on, which is the default, edges
+* are blended using their analytic pixel coverage: lines use Wu's
+* algorithm and ovals and rectangles compute the exact horizontal coverage
+* of their edges on four sub-scanlines per row. Interior spans are filled
+* without blending, so antialiased output costs little more than aliased.
+*/
+class Framebuffer : public RenderTarget {
+public:
+/*
+* Constructor: Framebuffer
+* Usage: Framebuffer fb(width, height);
+* -------------------------------------
+* Creates a framebuffer of the given size cleared to white, with the
+* drawing color set to black.
+*/
+Framebuffer(int width, int height);
+int getWidth() const;
+int getHeight() const;
+/*
+* Method: clear
+* Usage: fb.clear();
+* fb.clear(rgb);
+* --------------
+* Fills the whole framebuffer with rgb, or with white if omitted.
+*/
+void clear(int rgb = 0xFFFFFF);
+/*
+* Methods: setAntialiasing, isAntialiasing
+* Usage: fb.setAntialiasing(flag);
+* --------------------------------
+* Turns coverage blending on or off. With antialiasing off, a pixel is
+* painted if its center lies inside the shape.
+*/
+void setAntialiasing(bool flag);
+bool isAntialiasing() const;
+/*
+* Methods: setIdMode, isIdMode, setId
+* Usage: fb.setIdMode(true);
+* fb.setId(index + 1);
+* --------------------
+* In ID mode the framebuffer stores identifiers instead of colors: drawing
+* writes the 32-bit value given to setId, without blending and as if
+* antialiasing were off, so a pixel holds the id of the last shape drawn
+* over its center. setColor is ignored, which lets shapes draw themselves
+* unchanged. Turning the mode on sets the id to 0 and turning it off sets
+* the color to black; clear(0) empties the buffer of ids.
+*/
+void setIdMode(bool flag);
+bool isIdMode() const;
+void setId(uint32_t id);
+/*
+* Methods: setOrigin, getOriginX, getOriginY
+* Usage: fb.setOrigin(x, y);
+* --------------------------
+* Sets the scene coordinates of the framebuffer's top-left pixel, so that
+* a framebuffer smaller than the scene can render one band or tile of it.
+* The origin is (0, 0) by default.
+*/
+void setOrigin(int x, int y);
+int getOriginX() const;
+int getOriginY() const;
+/*
+* Method: getViewport
+* Usage: GRectangle visible = fb.getViewport();
+* ---------------------------------------------
+* Returns the rectangle of the scene the framebuffer covers, from its
+* origin to its width and height.
+*/
+virtual GRectangle getViewport() const;
+/*
+* Method: setColor
+* Usage: fb.setColor(color);
+* --------------------------
+* Sets the drawing color, given as a name or "#rrggbb" string accepted by
+* GWindow::setColor, as an 0xRRGGBB integer or as a resolved ColorId.
+* Names are resolved through the color table without allocating. Signals
+* an error if the color is not defined.
+*/
+void setColor(std::string_view color);
+void setColor(int rgb);
+virtual void setColor(ColorId color);
+/*
+* Methods: drawLine, fillRect, fillOval
+* Usage: fb.drawLine(x0, y0, x1, y1);
+* fb.fillRect(x, y, width, height);
+* fb.fillOval(x, y, width, height);
+* ---------------------------------
+* Draw into the framebuffer with the same geometry as the GWindow methods
+* of the same names. Lines are one pixel wide.
+*/
+virtual void drawLine(double x0, double y0, double x1, double y1);
+virtual void fillRect(double x, double y, double width, double height);
+virtual void fillOval(double x, double y, double width, double height);
+/*
+* Method: fillPolygon
+* Usage: fb.fillPolygon(coords, count, x, y, rule);
+* -------------------------------------------------
+* Fills the polygon whose count vertices are given as x0, y0, x1, y1, ...
+* relative to the point (x, y), using an active-edge table. With
+* antialiasing on, each row is sampled on four sub-scanlines and the
+* exact horizontal coverage of every span is accumulated per pixel.
+*/
+virtual void fillPolygon(const double *coords, int count, double x, double y,
+FillRule rule = NON_ZERO);
+/*
+* Methods: getPixel, getPixels
+* Usage: int rgb = fb.getPixel(x, y);
+* const uint32_t *row = fb.getPixels() + y * fb.getWidth();
+* ---------------------------------------------------------
+* Return the color of one pixel or the whole row-major pixel array, or
+* their ids in ID mode. The array of a framebuffer that is not const may
+* be written, to copy in pixels rendered elsewhere.
+*/
+int getPixel(int x, int y) const;
+const uint32_t *getPixels() const;
+uint32_t *getPixels();
+private:
+bool clipLine(double & x0, double & y0, double & x1, double & y1) const;
+void plot(int x, int y, double coverage);
+void blendSpan(int x, int y, int length, int alpha);
+int width;
+int height;
+int originX;
+int originY;
+uint32_t color;
+bool antialiasing;
+bool idMode;
+std::vector<uint32_t> pixels;
+std::vector<float> rowCoverage;
+std::vector<float> rowRuns;
+};
+#endif
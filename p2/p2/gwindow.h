@@ -11,6 +11,7 @@
 #include <string>
 #include "gtypes.h"
 #include "vector.h"
+#include "colortable.h"
 class GCompound;
 class GInteractor;
 class GLabel;
@@ -236,11 +237,13 @@ public:
  *
  * The color can also be specified as a string in the form "#rrggbb" where
  * rr, gg, and bb are pairs of hexadecimal digits indicating the red,
- * green, and blue components of the color.
+ * green, and blue components of the color, or as a ColorId obtained once
+ * from resolveColor in colortable.h.
  */
 
    void setColor(std::string color);
    void setColor(int color);
+   void setColor(ColorId color);
 
 /*
  * Method: getColor
@@ -513,6 +516,16 @@ void waitForClick();
 
 void exitGraphics();
 
+/*
+ * Implementation notes: setColor(ColorId)
+ * ---------------------------------------
+ * A ColorId has already been resolved, so it is passed on as an rgb value.
+ */
+
+inline void GWindow::setColor(ColorId color) {
+   setColor(color.getRGB());
+}
+
 #include "console.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+/*
+ * File: hitmap.cpp
+ * ----------------
+ * This file implements the HitMap class.
+ */
+
+#include "hitmap.h"
+#include "instrument.h"
+
+using namespace std;
+
+HitMap::HitMap() : ids(0, 0) {
+    originX = originY = 0;
+    shapeCount = 0;
+    generation = 0;
+}
+
+/*
+ * Implementation notes: build
+ * ---------------------------
+ * The shapes are drawn from back to front like ShapeList::draw, so each
+ * pixel ends up with the id of the last shape to cover it. Ids are one
+ * more than the index so that 0, the value the buffer is cleared to, means
+ * no shape. Shapes whose bounds miss the region are not drawn at all. The
+ * detail threshold and occlusion culling of the list are not applied,
+ * since both change which shape a pixel shows.
+ */
+
+void HitMap::build(const ShapeList & shapes, int x, int y, int width, int height) {
+    INSTRUMENT_SCOPE(PROBE_HIT_MAP_BUILD);
+    if (width != ids.getWidth() || height != ids.getHeight()) {
+        ids = Framebuffer(width, height);
+    }
+    ids.setIdMode(true);
+    ids.clear(0);
+    ids.setOrigin(x, y);
+    originX = x;
+    originY = y;
+    shapeCount = shapes.size();
+    generation = shapes.getGeneration();
+    INSTRUMENT_ITEMS(shapeCount);
+    double right = x + ids.getWidth();
+    double bottom = y + ids.getHeight();
+    for (int i = 0; i < shapeCount; i++) {
+        Shape *shape = shapes[i];
+        GRectangle bounds = shape->getBounds();
+        if (bounds.getX() > right || bounds.getY() > bottom
+            || bounds.getX() + bounds.getWidth() < x
+            || bounds.getY() + bounds.getHeight() < y) {
+            continue;
+        }
+        ids.setId((uint32_t) i + 1);
+        shape->draw(ids);
+    }
+}
+
+int HitMap::getX() const {
+    return originX;
+}
+
+int HitMap::getY() const {
+    return originY;
+}
+
+int HitMap::getWidth() const {
+    return ids.getWidth();
+}
+
+int HitMap::getHeight() const {
+    return ids.getHeight();
+}
+
+uint64_t HitMap::getGeneration() const {
+    return generation;
+}
+
+int HitMap::getIndexAt(int x, int y) const {
+    // Pixels outside the buffer read as 0, which is no shape
+    return ids.getPixel(x - originX, y - originY) - 1;
+}
+
+const uint32_t *HitMap::getIds() const {
+    return ids.getPixels();
+}
+
+void HitMap::countPixels(vector<int> & counts) const {
+    counts.assign(shapeCount, 0);
+    const uint32_t *p = ids.getPixels();
+    const uint32_t *end = p + (size_t) ids.getWidth() * ids.getHeight();
+    for (; p < end; p++) {
+        if (*p != 0) counts[*p - 1]++;
+    }
+}
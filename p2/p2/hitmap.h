@@ -0,0 +1,79 @@
+/*
+* File: hitmap.h
+* --------------
+* This file defines a HitMap class that records which shape is topmost at
+* every pixel of a region of a scene.
+*/
+#ifndef _hitmap_h
+#define _hitmap_h
+#include <cstdint>
+#include <vector>
+#include "framebuffer.h"
+#include "shapelist.h"
+/*
+* Class: HitMap
+* -------------
+* An ID buffer over a rectangle of pixels: build renders the shapes of a
+* ShapeList once, in ID mode, writing each shape's index instead of its
+* color, so afterward finding the shape at a pixel is an array lookup and
+* the whole region costs one rasterization instead of one hit test per
+* pixel. A pixel is assigned to the frontmost shape that covers its
+* center as the shape is drawn with antialiasing off, which for lines and
+* outlines means the pixels of their one-pixel pen; this can differ from
+* getShapeAt within a pixel of an edge. The map does not follow later
+* changes to the list; getGeneration tells whether it still describes it.
+*/
+class HitMap {
+public:
+HitMap();
+/*
+* Method: build
+* Usage: map.build(shapes, x, y, width, height);
+* ----------------------------------------------
+* Replaces the contents of the map with the topmost shape at each pixel of
+* the width by height region of the scene whose top-left pixel is (x, y).
+*/
+void build(const ShapeList & shapes, int x, int y, int width, int height);
+int getX() const;
+int getY() const;
+int getWidth() const;
+int getHeight() const;
+/*
+* Method: getGeneration
+* Usage: if (map.getGeneration() != shapes.getGeneration()) ...
+* -------------------------------------------------------------
+* Returns the generation of the list when the map was built.
+*/
+uint64_t getGeneration() const;
+/*
+* Method: getIndexAt
+* Usage: int index = map.getIndexAt(x, y);
+* ----------------------------------------
+* Returns the index in the list of the topmost shape at pixel (x, y) of
+* the scene, or -1 if no shape covers it or it lies outside the region.
+*/
+int getIndexAt(int x, int y) const;
+/*
+* Method: getIds
+* Usage: const uint32_t *row = map.getIds() + y * map.getWidth();
+* ----------------------------------------------------------------
+* Returns the row-major array of the region's pixels, each holding one
+* more than the index of its topmost shape, or 0 where there is none.
+*/
+const uint32_t *getIds() const;
+/*
+* Method: countPixels
+* Usage: map.countPixels(counts);
+* -------------------------------
+* Sets counts to one entry per shape in the list, holding the number of
+* pixels of the region at which that shape is topmost.
+*/
+void countPixels(std::vector<int> & counts) const;
+private:
+Framebuffer ids;
+int originX;
+int originY;
+int shapeCount;
+uint64_t generation;
+};
+#endif
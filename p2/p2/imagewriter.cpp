@@ -0,0 +1,496 @@
+#include "imagewriter.h"
+#include "framebuffer.h"
+#include "shapelist.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+// Implementation notes: ImageWriter class
+//
+// The caller's thread only copies rows into a band buffer, recycled from
+// a spare pool, and appends it to the pending queue.  The worker thread
+// pops bands and runs them through an ImageEncoder, which appends the
+// encoded bytes to an OutputBuffer that writes to the file in large
+// blocks.  A failure on the worker is stored and rethrown to the caller.
+
+namespace {
+
+const size_t MAX_PENDING_BANDS = 3;
+const size_t OUTPUT_BLOCK_SIZE = 1 << 20;
+
+class OutputBuffer {
+public:
+    explicit OutputBuffer(FILE *file) {
+        this->file = file;
+        bytes.reserve(OUTPUT_BLOCK_SIZE);
+    }
+
+    void append(const uint8_t *data, size_t n) {
+        bytes.insert(bytes.end(), data, data + n);
+        if (bytes.size() >= OUTPUT_BLOCK_SIZE) flush();
+    }
+
+    void append(const vector<uint8_t> & data) {
+        append(data.data(), data.size());
+    }
+
+    void flush() {
+        if (bytes.empty()) return;
+        if (fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+            throw runtime_error("ImageWriter: write failed.");
+        }
+        bytes.clear();
+    }
+
+private:
+    FILE *file;
+    vector<uint8_t> bytes;
+};
+
+}
+
+/*
+ * Class: ImageEncoder
+ * -------------------
+ * The format-specific half of the writer.  All three methods run on the
+ * worker thread.
+ */
+
+class ImageEncoder {
+public:
+    virtual ~ImageEncoder() {}
+    virtual void begin(int width, int height, OutputBuffer & out) = 0;
+    virtual void encodeRows(const uint32_t *pixels, int rows,
+                            OutputBuffer & out) = 0;
+    virtual void end(OutputBuffer & out) = 0;
+};
+
+namespace {
+
+class PPMEncoder : public ImageEncoder {
+public:
+    virtual void begin(int width, int height, OutputBuffer & out) {
+        this->width = width;
+        string header = "P6\n" + to_string(width) + " " + to_string(height)
+                      + "\n255\n";
+        out.append((const uint8_t *) header.data(), header.size());
+    }
+
+    virtual void encodeRows(const uint32_t *pixels, int rows,
+                            OutputBuffer & out) {
+        size_t n = (size_t) width * rows;
+        rgb.resize(n * 3);
+        for (size_t i = 0; i < n; i++) {
+            rgb[3 * i] = (uint8_t) (pixels[i] >> 16);
+            rgb[3 * i + 1] = (uint8_t) (pixels[i] >> 8);
+            rgb[3 * i + 2] = (uint8_t) pixels[i];
+        }
+        out.append(rgb);
+    }
+
+    virtual void end(OutputBuffer &) {
+    }
+
+private:
+    int width;
+    vector<uint8_t> rgb;
+};
+
+/*
+ * Class: Deflater
+ * ---------------
+ * A streaming deflate compressor that emits one block of fixed Huffman
+ * codes per call to compress.  Matches are found with a single-probe hash
+ * of the next three bytes over a 32K window that carries over from one
+ * call to the next, which suits the long runs in rendered scenes without
+ * the cost of building dynamic code tables.
+ */
+
+class Deflater {
+public:
+    Deflater() : head(HASH_SIZE, -1) {
+        base = 0;
+        bitBuffer = 0;
+        bitCount = 0;
+    }
+
+    void compress(const uint8_t *data, size_t n, vector<uint8_t> & out) {
+        if (n == 0) return;
+        size_t start = window.size();
+        window.insert(window.end(), data, data + n);
+        putBits(0, 1, out);
+        putBits(1, 2, out);
+        size_t end = window.size();
+        size_t i = start;
+        while (i < end) {
+            int length = 0;
+            size_t distance = 0;
+            if (end - i >= MIN_MATCH) {
+                int h = hash(i);
+                long long candidate = head[h];
+                long long position = base + (long long) i;
+                head[h] = position;
+                if (candidate >= base
+                        && position - candidate <= (long long) WINDOW_SIZE) {
+                    size_t j = (size_t) (candidate - base);
+                    size_t limit = min((size_t) MAX_MATCH, end - i);
+                    size_t k = 0;
+                    while (k < limit && window[j + k] == window[i + k]) k++;
+                    if (k >= MIN_MATCH) {
+                        length = (int) k;
+                        distance = i - j;
+                    }
+                }
+            }
+            if (length == 0) {
+                putLiteral(window[i], out);
+                i++;
+            } else {
+                putMatch(length, (int) distance, out);
+                for (size_t k = i + 1; k < i + length; k++) {
+                    if (end - k >= MIN_MATCH) head[hash(k)] = base + (long long) k;
+                }
+                i += length;
+            }
+        }
+        putCode(0, 7, out);
+        if (window.size() > WINDOW_SIZE) {
+            size_t drop = window.size() - WINDOW_SIZE;
+            window.erase(window.begin(), window.begin() + drop);
+            base += (long long) drop;
+        }
+    }
+
+    // Ends the stream with an empty final block and pads to a byte
+    void finish(vector<uint8_t> & out) {
+        putBits(1, 1, out);
+        putBits(1, 2, out);
+        putCode(0, 7, out);
+        if (bitCount > 0) putBits(0, 8 - bitCount, out);
+    }
+
+private:
+    static const int HASH_SIZE = 1 << 15;
+    static const size_t WINDOW_SIZE = 32768;
+    static const size_t MIN_MATCH = 3;
+    static const int MAX_MATCH = 258;
+
+    int hash(size_t i) const {
+        return ((window[i] << 10) ^ (window[i + 1] << 5) ^ window[i + 2])
+               & (HASH_SIZE - 1);
+    }
+
+    void putBits(uint32_t bits, int count, vector<uint8_t> & out) {
+        bitBuffer |= (uint64_t) bits << bitCount;
+        bitCount += count;
+        while (bitCount >= 8) {
+            out.push_back((uint8_t) bitBuffer);
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    // Huffman codes are packed starting from their most significant bit
+    void putCode(uint32_t code, int length, vector<uint8_t> & out) {
+        uint32_t reversed = 0;
+        for (int k = 0; k < length; k++) {
+            reversed = (reversed << 1) | ((code >> k) & 1);
+        }
+        putBits(reversed, length, out);
+    }
+
+    void putLiteral(int symbol, vector<uint8_t> & out) {
+        if (symbol < 144) {
+            putCode(0x30 + symbol, 8, out);
+        } else if (symbol < 256) {
+            putCode(0x190 + symbol - 144, 9, out);
+        } else if (symbol < 280) {
+            putCode(symbol - 256, 7, out);
+        } else {
+            putCode(0xC0 + symbol - 280, 8, out);
+        }
+    }
+
+    void putMatch(int length, int distance, vector<uint8_t> & out) {
+        static const int LENGTH_BASE[] = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+        };
+        static const int LENGTH_EXTRA[] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+        };
+        static const int DISTANCE_BASE[] = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+            8193, 12289, 16385, 24577
+        };
+        static const int DISTANCE_EXTRA[] = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+        };
+        int lc = (int) (upper_bound(LENGTH_BASE, LENGTH_BASE + 29, length)
+                        - LENGTH_BASE) - 1;
+        putLiteral(257 + lc, out);
+        putBits(length - LENGTH_BASE[lc], LENGTH_EXTRA[lc], out);
+        int dc = (int) (upper_bound(DISTANCE_BASE, DISTANCE_BASE + 30, distance)
+                        - DISTANCE_BASE) - 1;
+        putCode(dc, 5, out);
+        putBits(distance - DISTANCE_BASE[dc], DISTANCE_EXTRA[dc], out);
+    }
+
+    vector<uint8_t> window;
+    vector<long long> head;
+    long long base;
+    uint64_t bitBuffer;
+    int bitCount;
+};
+
+struct CRCTable {
+    uint32_t entries[256];
+
+    CRCTable() {
+        for (uint32_t k = 0; k < 256; k++) {
+            uint32_t c = k;
+            for (int b = 0; b < 8; b++) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            entries[k] = c;
+        }
+    }
+};
+
+uint32_t crc32(uint32_t crc, const uint8_t *data, size_t n) {
+    static const CRCTable table;
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/*
+ * Class: PNGEncoder
+ * -----------------
+ * Each band of rows is filtered with the Sub filter, which turns flat
+ * color runs into zeros, compressed into one deflate block and written
+ * as its own IDAT chunk, so compressed data reaches the file as soon as
+ * the band is encoded.
+ */
+
+class PNGEncoder : public ImageEncoder {
+public:
+    virtual void begin(int width, int height, OutputBuffer & out) {
+        this->width = width;
+        adlerA = 1;
+        adlerB = 0;
+        static const uint8_t SIGNATURE[] = {
+            0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+        };
+        out.append(SIGNATURE, sizeof SIGNATURE);
+        vector<uint8_t> header;
+        putInt(header, width);
+        putInt(header, height);
+        header.push_back(8);              // Bit depth
+        header.push_back(2);              // Color type: RGB
+        header.push_back(0);              // Deflate compression
+        header.push_back(0);              // Adaptive filtering
+        header.push_back(0);              // No interlace
+        writeChunk("IHDR", header, out);
+        compressed.push_back(0x78);       // zlib header: deflate, 32K window
+        compressed.push_back(0x01);
+    }
+
+    virtual void encodeRows(const uint32_t *pixels, int rows,
+                            OutputBuffer & out) {
+        size_t stride = 1 + (size_t) width * 3;
+        raw.resize(stride * rows);
+        for (int j = 0; j < rows; j++) {
+            uint8_t *row = raw.data() + j * stride;
+            const uint32_t *src = pixels + (size_t) j * width;
+            row[0] = 1;                   // Sub filter
+            uint32_t previous = 0;
+            for (int i = 0; i < width; i++) {
+                uint32_t p = src[i];
+                row[1 + 3 * i] = (uint8_t) ((p >> 16) - (previous >> 16));
+                row[2 + 3 * i] = (uint8_t) ((p >> 8) - (previous >> 8));
+                row[3 + 3 * i] = (uint8_t) (p - previous);
+                previous = p;
+            }
+        }
+        updateAdler(raw.data(), raw.size());
+        deflater.compress(raw.data(), raw.size(), compressed);
+        writeChunk("IDAT", compressed, out);
+        compressed.clear();
+    }
+
+    virtual void end(OutputBuffer & out) {
+        deflater.finish(compressed);
+        putInt(compressed, (adlerB << 16) | adlerA);
+        writeChunk("IDAT", compressed, out);
+        writeChunk("IEND", vector<uint8_t>(), out);
+    }
+
+private:
+    static void putInt(vector<uint8_t> & bytes, uint32_t value) {
+        bytes.push_back((uint8_t) (value >> 24));
+        bytes.push_back((uint8_t) (value >> 16));
+        bytes.push_back((uint8_t) (value >> 8));
+        bytes.push_back((uint8_t) value);
+    }
+
+    static void writeChunk(const char *type, const vector<uint8_t> & data,
+                           OutputBuffer & out) {
+        vector<uint8_t> prefix;
+        putInt(prefix, (uint32_t) data.size());
+        prefix.insert(prefix.end(), type, type + 4);
+        uint32_t crc = crc32(0, prefix.data() + 4, 4);
+        crc = crc32(crc, data.data(), data.size());
+        vector<uint8_t> suffix;
+        putInt(suffix, crc);
+        out.append(prefix);
+        out.append(data);
+        out.append(suffix);
+    }
+
+    void updateAdler(const uint8_t *data, size_t n) {
+        while (n > 0) {
+            size_t chunk = min(n, (size_t) 5552);
+            for (size_t i = 0; i < chunk; i++) {
+                adlerA += data[i];
+                adlerB += adlerA;
+            }
+            adlerA %= 65521;
+            adlerB %= 65521;
+            data += chunk;
+            n -= chunk;
+        }
+    }
+
+    int width;
+    uint32_t adlerA, adlerB;
+    Deflater deflater;
+    vector<uint8_t> raw;
+    vector<uint8_t> compressed;
+};
+
+}
+
+ImageWriter::ImageWriter(const string & filename, int width, int height,
+                         ImageFormat format) {
+    if (width <= 0 || height <= 0) {
+        throw runtime_error("ImageWriter: image size must be positive.");
+    }
+    file = fopen(filename.c_str(), "wb");
+    if (file == NULL) {
+        throw runtime_error("ImageWriter: cannot open " + filename);
+    }
+    this->width = width;
+    this->height = height;
+    rowsQueued = 0;
+    closing = false;
+    closed = false;
+    if (format == IMAGE_PNG) {
+        encoder = new PNGEncoder();
+    } else {
+        encoder = new PPMEncoder();
+    }
+    worker = thread(&ImageWriter::encodeLoop, this);
+}
+
+ImageWriter::~ImageWriter() {
+    try {
+        close();
+    } catch (...) {
+        // Destructors must not throw; call close to observe errors
+    }
+}
+
+void ImageWriter::writeRows(const uint32_t *pixels, int rows) {
+    if (rows <= 0) return;
+    if (closed || rowsQueued + rows > height) {
+        throw runtime_error("ImageWriter: rows exceed the image height.");
+    }
+    unique_lock<mutex> guard(lock);
+    bandDone.wait(guard, [this] {
+        return pending.size() < MAX_PENDING_BANDS || failure;
+    });
+    if (failure) rethrow_exception(failure);
+    Band band;
+    if (!spare.empty()) {
+        band.pixels.swap(spare.back());
+        spare.pop_back();
+    }
+    guard.unlock();
+    band.pixels.assign(pixels, pixels + (size_t) width * rows);
+    band.rows = rows;
+    rowsQueued += rows;
+    guard.lock();
+    pending.push_back(std::move(band));
+    bandReady.notify_one();
+}
+
+void ImageWriter::close() {
+    if (closed) return;
+    {
+        lock_guard<mutex> guard(lock);
+        closing = true;
+    }
+    bandReady.notify_one();
+    worker.join();
+    closed = true;
+    delete encoder;
+    encoder = NULL;
+    bool ok = fclose(file) == 0;
+    if (failure) rethrow_exception(failure);
+    if (!ok) throw runtime_error("ImageWriter: write failed.");
+    if (rowsQueued != height) {
+        throw runtime_error("ImageWriter: image is missing rows.");
+    }
+}
+
+void ImageWriter::encodeLoop() {
+    OutputBuffer out(file);
+    try {
+        encoder->begin(width, height, out);
+        while (true) {
+            Band band;
+            {
+                unique_lock<mutex> guard(lock);
+                bandReady.wait(guard, [this] {
+                    return !pending.empty() || closing;
+                });
+                if (pending.empty()) break;
+                band = std::move(pending.front());
+                pending.pop_front();
+            }
+            encoder->encodeRows(band.pixels.data(), band.rows, out);
+            lock_guard<mutex> guard(lock);
+            spare.push_back(std::move(band.pixels));
+            bandDone.notify_one();
+        }
+        encoder->end(out);
+        out.flush();
+    } catch (...) {
+        lock_guard<mutex> guard(lock);
+        failure = current_exception();
+        pending.clear();
+        bandDone.notify_one();
+    }
+}
+
+void exportScene(const ShapeList & shapes, int width, int height,
+                 const string & filename, ImageFormat format,
+                 int bandHeight) {
+    bandHeight = max(1, min(bandHeight, height));
+    ImageWriter writer(filename, width, height, format);
+    Framebuffer fb(width, bandHeight);
+    for (int y = 0; y < height; y += bandHeight) {
+        fb.clear();
+        fb.setOrigin(0, y);
+        shapes.draw(fb);
+        writer.writeRows(fb.getPixels(), min(bandHeight, height - y));
+    }
+    writer.close();
+}
@@ -0,0 +1,109 @@
+/*
+* File: imagewriter.h
+* -------------------
+* This file defines an ImageWriter class that encodes rendered pixel rows
+* to a PPM or PNG file on a background thread, and an exportScene function
+* that renders a ShapeList into such a file one band at a time.
+*/
+#ifndef _imagewriter_h
+#define _imagewriter_h
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+class ShapeList;
+class ImageEncoder;
+/*
+* Type: ImageFormat
+* -----------------
+* The file formats understood by ImageWriter. IMAGE_PPM is the binary P6
+* form, which is the fastest to write. IMAGE_PNG is 8-bit RGB compressed
+* with the writer's own deflate implementation.
+*/
+enum ImageFormat { IMAGE_PPM, IMAGE_PNG };
+/*
+* Class: ImageWriter
+* ------------------
+* Writes an image of a fixed size from top to bottom. Each call to
+* writeRows copies the rows into a queue and returns at once, and a
+* background thread encodes and writes them while the caller rasterizes
+* the next band. Output is gathered into large buffers before it reaches
+* the file. A small number of bands may be queued; beyond that, writeRows
+* waits for the encoder to catch up.
+*/
+class ImageWriter {
+public:
+/*
+* Constructor: ImageWriter
+* Usage: ImageWriter writer(filename, width, height, format);
+* -----------------------------------------------------------
+* Opens filename for writing and starts the encoder thread. Throws a
+* runtime_error if the file cannot be created.
+*/
+ImageWriter(const std::string & filename, int width, int height,
+ImageFormat format);
+/*
+* Destructor: ~ImageWriter
+* ------------------------
+* Closes the writer if close has not been called, discarding any error.
+*/
+~ImageWriter();
+/*
+* Method: writeRows
+* Usage: writer.writeRows(pixels, rows);
+* --------------------------------------
+* Queues the next rows of the image, given as rows * width 0xRRGGBB
+* values such as those returned by Framebuffer::getPixels. Throws a
+* runtime_error if the rows run past the bottom of the image or if the
+* encoder has failed.
+*/
+void writeRows(const uint32_t *pixels, int rows);
+/*
+* Method: close
+* Usage: writer.close();
+* ----------------------
+* Waits for all queued rows to be written and closes the file. Throws a
+* runtime_error if writing failed or if fewer rows than the image height
+* were written.
+*/
+void close();
+private:
+ImageWriter(const ImageWriter & src);
+ImageWriter & operator=(const ImageWriter & src);
+void encodeLoop();
+struct Band {
+std::vector<uint32_t> pixels;
+int rows;
+};
+int width;
+int height;
+int rowsQueued;
+bool closing;
+bool closed;
+std::FILE *file;
+ImageEncoder *encoder;
+std::exception_ptr failure;
+std::deque<Band> pending;
+std::vector<std::vector<uint32_t> > spare;
+std::mutex lock;
+std::condition_variable bandReady;
+std::condition_variable bandDone;
+std::thread worker;
+};
+/*
+* Function: exportScene
+* Usage: exportScene(shapes, width, height, filename, format);
+* ------------------------------------------------------------
+* Renders the shapes into an image file of the given size. The scene is
+* rasterized by a Framebuffer one band of bandHeight rows at a time, and
+* each band is encoded on the writer's thread while the next is drawn.
+*/
+void exportScene(const ShapeList & shapes, int width, int height,
+const std::string & filename, ImageFormat format,
+int bandHeight = 64);
+#endif
@@ -0,0 +1,169 @@
+/*
+ * File: instrument.cpp
+ * --------------------
+ * This file implements the snapshot side of the instrumentation layer.
+ */
+
+#include "instrument.h"
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+using namespace std;
+
+namespace {
+
+const char *const PROBE_NAMES[PROBE_COUNT] = {
+   "ShapeList::draw",
+   "ShapeList::getShapeAt",
+   "Shape::contains",
+   "ShapeList::moveToFront",
+   "ShapeList::moveToBack",
+   "ShapeList::moveForward",
+   "ShapeList::moveBackward",
+   "Vector::expandCapacity",
+   "ShapeList::draw (culled)",
+   "HitMap::build",
+   "TileCache::renderTile"
+};
+
+}
+
+#ifdef SHAPES_INSTRUMENT
+
+#include <vector>
+
+/*
+ * Implementation notes: registry
+ * ------------------------------
+ * The registry is allocated once and never freed, so that thread-local
+ * counter blocks destroyed during program exit can still fold their
+ * totals into it.  The cycle counter is calibrated against steady_clock
+ * over the interval since the registry was created, so no startup delay
+ * is needed to measure its frequency.
+ */
+
+namespace {
+
+struct ProbeRegistry {
+   mutex lock;
+   vector<ProbeCounters *> live;
+   ProbeStats retired[PROBE_COUNT];
+   ProbeStats baseline[PROBE_COUNT];
+   uint64_t startTicks;
+   chrono::steady_clock::time_point startTime;
+
+   ProbeRegistry() {
+      for (int i = 0; i < PROBE_COUNT; i++) {
+         retired[i] = baseline[i] = ProbeStats { PROBE_NAMES[i], 0, 0, 0, 0 };
+      }
+      startTicks = readCycleCounter();
+      startTime = chrono::steady_clock::now();
+   }
+};
+
+ProbeRegistry & registry() {
+   static ProbeRegistry *instance = new ProbeRegistry();
+   return *instance;
+}
+
+/* Must be called with the registry locked; times are left in ticks */
+void sumProbes(ProbeRegistry & reg, ProbeStats totals[]) {
+   for (int i = 0; i < PROBE_COUNT; i++) {
+      totals[i] = reg.retired[i];
+      for (ProbeCounters *counters : reg.live) {
+         totals[i].calls += counters->calls[i].load(memory_order_relaxed);
+         totals[i].nanoseconds += counters->ticks[i].load(memory_order_relaxed);
+         totals[i].items += counters->items[i].load(memory_order_relaxed);
+         totals[i].bytes += counters->bytes[i].load(memory_order_relaxed);
+      }
+   }
+}
+
+}
+
+ProbeCounters::ProbeCounters() {
+   for (int i = 0; i < PROBE_COUNT; i++) {
+      calls[i] = ticks[i] = items[i] = bytes[i] = 0;
+   }
+   ProbeRegistry & reg = registry();
+   lock_guard<mutex> guard(reg.lock);
+   reg.live.push_back(this);
+}
+
+ProbeCounters::~ProbeCounters() {
+   ProbeRegistry & reg = registry();
+   lock_guard<mutex> guard(reg.lock);
+   for (int i = 0; i < PROBE_COUNT; i++) {
+      reg.retired[i].calls += calls[i].load(memory_order_relaxed);
+      reg.retired[i].nanoseconds += ticks[i].load(memory_order_relaxed);
+      reg.retired[i].items += items[i].load(memory_order_relaxed);
+      reg.retired[i].bytes += bytes[i].load(memory_order_relaxed);
+   }
+   for (size_t k = 0; k < reg.live.size(); k++) {
+      if (reg.live[k] == this) {
+         reg.live.erase(reg.live.begin() + k);
+         break;
+      }
+   }
+}
+
+vector<ProbeStats> getProbeSnapshot() {
+   ProbeRegistry & reg = registry();
+   ProbeStats totals[PROBE_COUNT];
+   uint64_t ticks;
+   chrono::steady_clock::time_point now;
+   {
+      lock_guard<mutex> guard(reg.lock);
+      sumProbes(reg, totals);
+      for (int i = 0; i < PROBE_COUNT; i++) {
+         totals[i].calls -= reg.baseline[i].calls;
+         totals[i].nanoseconds -= reg.baseline[i].nanoseconds;
+         totals[i].items -= reg.baseline[i].items;
+         totals[i].bytes -= reg.baseline[i].bytes;
+      }
+      ticks = readCycleCounter() - reg.startTicks;
+      now = chrono::steady_clock::now();
+   }
+   double elapsed = chrono::duration<double, nano>(now - reg.startTime).count();
+   double scale = (ticks == 0) ? 1 : elapsed / ticks;
+   vector<ProbeStats> result(totals, totals + PROBE_COUNT);
+   for (ProbeStats & stats : result) {
+      stats.nanoseconds = (uint64_t) (stats.nanoseconds * scale);
+   }
+   return result;
+}
+
+void resetProbes() {
+   ProbeRegistry & reg = registry();
+   lock_guard<mutex> guard(reg.lock);
+   sumProbes(reg, reg.baseline);
+}
+
+#else
+
+vector<ProbeStats> getProbeSnapshot() {
+   vector<ProbeStats> result;
+   for (int i = 0; i < PROBE_COUNT; i++) {
+      result.push_back(ProbeStats { PROBE_NAMES[i], 0, 0, 0, 0 });
+   }
+   return result;
+}
+
+void resetProbes() {
+}
+
+#endif
+
+void dumpProbes(ostream & os) {
+   os << left << setw(26) << "probe" << right
+      << setw(12) << "calls" << setw(16) << "ns"
+      << setw(12) << "ns/call" << setw(14) << "items"
+      << setw(14) << "bytes" << endl;
+   for (const ProbeStats & stats : getProbeSnapshot()) {
+      os << left << setw(26) << stats.name << right
+         << setw(12) << stats.calls << setw(16) << stats.nanoseconds
+         << setw(12) << (stats.calls == 0 ? 0 : stats.nanoseconds / stats.calls)
+         << setw(14) << stats.items << setw(14) << stats.bytes << endl;
+   }
+}
@@ -0,0 +1,203 @@
+/*
+ * File: instrument.h
+ * ------------------
+ * This file exports a lightweight instrumentation layer for the drawing
+ * and hit-testing hot paths.  It is compiled in only when the macro
+ * SHAPES_INSTRUMENT is defined; otherwise the INSTRUMENT_* macros expand
+ * to nothing and the snapshot functions report zeros.
+ */
+
+#ifndef _instrument_h
+#define _instrument_h
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+/*
+ * Type: Probe
+ * -----------
+ * The instrumented operations.  PROBE_SHAPE_CONTAINS counts the calls made
+ * by hit-testing loops but is not timed, since reading the clock around
+ * every containment test would cost more than the test itself.
+ * PROBE_OCCLUSION_CULLED counts, as items, the shapes that draw skipped
+ * because shapes in front of them hid them.
+ */
+
+enum Probe {
+   PROBE_SHAPELIST_DRAW,
+   PROBE_GET_SHAPE_AT,
+   PROBE_SHAPE_CONTAINS,
+   PROBE_MOVE_TO_FRONT,
+   PROBE_MOVE_TO_BACK,
+   PROBE_MOVE_FORWARD,
+   PROBE_MOVE_BACKWARD,
+   PROBE_VECTOR_EXPAND,
+   PROBE_OCCLUSION_CULLED,
+   PROBE_HIT_MAP_BUILD,
+   PROBE_TILE_RENDER,
+   PROBE_COUNT
+};
+
+/*
+ * Type: ProbeStats
+ * ----------------
+ * The totals for one probe.  For draw, getShapeAt and HitMap::build,
+ * items counts the shapes visited; for Vector expansion, calls counts
+ * reallocations and bytes counts the element bytes copied into the new
+ * arrays.
+ */
+
+struct ProbeStats {
+   const char *name;
+   uint64_t calls;
+   uint64_t nanoseconds;
+   uint64_t items;
+   uint64_t bytes;
+};
+
+/*
+ * Function: getProbeSnapshot
+ * Usage: std::vector<ProbeStats> stats = getProbeSnapshot();
+ * ----------------------------------------------------------
+ * Aggregates the counters of every thread, including threads that have
+ * exited, into one ProbeStats entry per probe, indexed by Probe.
+ */
+
+std::vector<ProbeStats> getProbeSnapshot();
+
+/*
+ * Function: dumpProbes
+ * Usage: dumpProbes(os);
+ * ----------------------
+ * Writes a snapshot to os as a table with one line per probe.
+ */
+
+void dumpProbes(std::ostream & os);
+
+/*
+ * Function: resetProbes
+ * Usage: resetProbes();
+ * ---------------------
+ * Makes subsequent snapshots count from zero.
+ */
+
+void resetProbes();
+
+/* Private section */
+
+/**********************************************************************/
+/* Note: Everything below this point in the file is logically part    */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+#ifdef SHAPES_INSTRUMENT
+
+#include <atomic>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Implementation notes: per-thread counters
+ * -----------------------------------------
+ * Each thread updates its own block of counters, so the hot path never
+ * contends or issues a locked instruction.  The counters are atomics only
+ * so that a snapshot taken on another thread can read them; the owning
+ * thread updates them with a relaxed load and store.  Blocks register
+ * themselves on first use and fold their totals into a global sum when
+ * their thread exits.  Times are kept in raw cycle-counter ticks and
+ * converted to nanoseconds when a snapshot is taken.
+ */
+
+struct ProbeCounters {
+   std::atomic<uint64_t> calls[PROBE_COUNT];
+   std::atomic<uint64_t> ticks[PROBE_COUNT];
+   std::atomic<uint64_t> items[PROBE_COUNT];
+   std::atomic<uint64_t> bytes[PROBE_COUNT];
+
+   ProbeCounters();
+   ~ProbeCounters();
+};
+
+inline ProbeCounters & localProbeCounters() {
+   static thread_local ProbeCounters counters;
+   return counters;
+}
+
+inline void bumpProbeCounter(std::atomic<uint64_t> & counter, uint64_t n) {
+   counter.store(counter.load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+}
+
+inline uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#elif defined(__aarch64__)
+   uint64_t ticks;
+   asm volatile("mrs %0, cntvct_el0" : "=r" (ticks));
+   return ticks;
+#else
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline void recordProbe(Probe probe, uint64_t calls, uint64_t items,
+                        uint64_t bytes) {
+   ProbeCounters & counters = localProbeCounters();
+   bumpProbeCounter(counters.calls[probe], calls);
+   bumpProbeCounter(counters.items[probe], items);
+   bumpProbeCounter(counters.bytes[probe], bytes);
+}
+
+class ProbeTimer {
+public:
+   explicit ProbeTimer(Probe probe) {
+      this->probe = probe;
+      items = 0;
+      bytes = 0;
+      start = readCycleCounter();
+   }
+
+   ~ProbeTimer() {
+      uint64_t elapsed = readCycleCounter() - start;
+      ProbeCounters & counters = localProbeCounters();
+      bumpProbeCounter(counters.calls[probe], 1);
+      bumpProbeCounter(counters.ticks[probe], elapsed);
+      bumpProbeCounter(counters.items[probe], items);
+      bumpProbeCounter(counters.bytes[probe], bytes);
+   }
+
+   void addItems(uint64_t n) {
+      items += n;
+   }
+
+   void addBytes(uint64_t n) {
+      bytes += n;
+   }
+
+private:
+   Probe probe;
+   uint64_t items;
+   uint64_t bytes;
+   uint64_t start;
+};
+
+#define INSTRUMENT_SCOPE(probe) ProbeTimer probeTimer_(probe)
+#define INSTRUMENT_ITEMS(n) probeTimer_.addItems(n)
+#define INSTRUMENT_BYTES(n) probeTimer_.addBytes(n)
+#define INSTRUMENT_COUNT(probe, calls, items, bytes) \
+   recordProbe(probe, calls, items, bytes)
+
+#else
+
+#define INSTRUMENT_SCOPE(probe) ((void) 0)
+#define INSTRUMENT_ITEMS(n) ((void) (n))
+#define INSTRUMENT_BYTES(n) ((void) (n))
+#define INSTRUMENT_COUNT(probe, calls, items, bytes) ((void) 0)
+
+#endif
+
+#endif
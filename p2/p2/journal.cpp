@@ -0,0 +1,264 @@
+/*
+ * File: journal.cpp
+ * -----------------
+ * This file implements the EditJournal class.
+ */
+
+#include "journal.h"
+#include "bytestream.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+/*
+ * Implementation notes: EditJournal
+ * ---------------------------------
+ * Every record holds both directions of its change, so undo and redo are
+ * the same operation applied backward or forward, and a record moves
+ * between the two stacks unchanged.  Locations are recorded as absolute
+ * points rather than offsets, so undoing a move restores the original
+ * coordinates exactly instead of subtracting the offset back out.
+ *
+ * Whether the journal owns a record's shape depends on the stack the
+ * record is on: a removal that has been done and an insertion that has
+ * been undone both leave the shape outside the list.  Those are the two
+ * cases in which discarding a record deletes its shape.  The oldest
+ * records are discarded first, so a record never outlives one that
+ * deletes its shape.
+ */
+
+namespace {
+
+const size_t DEFAULT_BUDGET = 1 << 20;
+
+// Estimates the memory held by a shape from the size of its encoding
+size_t shapeBytes(const Shape *sp) {
+    string encoding;
+    ByteWriter out(encoding);
+    sp->encode(out);
+    return encoding.size();
+}
+
+}
+
+EditJournal::EditJournal(ShapeList & shapes) : shapes(shapes) {
+    budget = DEFAULT_BUDGET;
+    usage = 0;
+    coalescing = false;
+}
+
+EditJournal::~EditJournal() {
+    clear();
+}
+
+void EditJournal::move(Shape *sp, double dx, double dy) {
+    GPoint old = sp->getLocation();
+    sp->move(dx, dy);
+    recordLocation(sp, old);
+}
+
+void EditJournal::setLocation(Shape *sp, double x, double y) {
+    GPoint old = sp->getLocation();
+    sp->setLocation(x, y);
+    recordLocation(sp, old);
+}
+
+void EditJournal::setColor(Shape *sp, const string & color) {
+    Edit edit = { COLOR, sp, 0, 0, 0, 0, sp->getColor(), color, 0, 0, 0 };
+    sp->setColor(color);
+    record(std::move(edit));
+}
+
+void EditJournal::add(Shape *sp) {
+    shapes.add(sp);
+    int index = shapes.size() - 1;
+    Edit edit = { INSERT, sp, 0, 0, 0, 0, "", "", index, index, 0 };
+    record(std::move(edit));
+}
+
+void EditJournal::remove(Shape *sp) {
+    int index = indexOf(sp);
+    if (index < 0) {
+        throw runtime_error("Shape not found in ShapeList.");
+    }
+    shapes.remove(index);
+    Edit edit = { REMOVE, sp, 0, 0, 0, 0, "", "", index, index, 0 };
+    record(std::move(edit));
+}
+
+void EditJournal::moveToFront(Shape *sp) {
+    int from = indexOf(sp);
+    shapes.moveToFront(sp);
+    recordReorder(sp, from);
+}
+
+void EditJournal::moveToBack(Shape *sp) {
+    int from = indexOf(sp);
+    shapes.moveToBack(sp);
+    recordReorder(sp, from);
+}
+
+void EditJournal::moveForward(Shape *sp) {
+    int from = indexOf(sp);
+    shapes.moveForward(sp);
+    recordReorder(sp, from);
+}
+
+void EditJournal::moveBackward(Shape *sp) {
+    int from = indexOf(sp);
+    shapes.moveBackward(sp);
+    recordReorder(sp, from);
+}
+
+void EditJournal::checkpoint() {
+    coalescing = false;
+}
+
+bool EditJournal::undo() {
+    if (undoStack.empty()) return false;
+    coalescing = false;
+    Edit edit = std::move(undoStack.back());
+    undoStack.pop_back();
+    apply(edit, false);
+    redoStack.push_back(std::move(edit));
+    return true;
+}
+
+bool EditJournal::redo() {
+    if (redoStack.empty()) return false;
+    coalescing = false;
+    Edit edit = std::move(redoStack.back());
+    redoStack.pop_back();
+    apply(edit, true);
+    undoStack.push_back(std::move(edit));
+    return true;
+}
+
+bool EditJournal::canUndo() const {
+    return !undoStack.empty();
+}
+
+bool EditJournal::canRedo() const {
+    return !redoStack.empty();
+}
+
+int EditJournal::getUndoCount() const {
+    return (int) undoStack.size();
+}
+
+int EditJournal::getRedoCount() const {
+    return (int) redoStack.size();
+}
+
+void EditJournal::setMemoryBudget(size_t bytes) {
+    budget = bytes;
+    trim();
+}
+
+size_t EditJournal::getMemoryBudget() const {
+    return budget;
+}
+
+size_t EditJournal::getMemoryUsage() const {
+    return usage;
+}
+
+void EditJournal::clear() {
+    for (Edit & edit : undoStack) {
+        discard(edit, true);
+    }
+    for (Edit & edit : redoStack) {
+        discard(edit, false);
+    }
+    undoStack.clear();
+    redoStack.clear();
+    coalescing = false;
+}
+
+void EditJournal::record(Edit && edit) {
+    for (Edit & undone : redoStack) {
+        discard(undone, false);
+    }
+    redoStack.clear();
+    coalescing = false;
+    edit.bytes = sizeof(Edit) + edit.oldColor.capacity()
+                              + edit.newColor.capacity();
+    if (edit.kind == INSERT || edit.kind == REMOVE) {
+        edit.bytes += shapeBytes(edit.shape);
+    }
+    usage += edit.bytes;
+    undoStack.push_back(std::move(edit));
+    trim();
+}
+
+void EditJournal::apply(const Edit & edit, bool forward) {
+    switch (edit.kind) {
+    case LOCATION:
+        if (forward) {
+            edit.shape->setLocation(edit.newX, edit.newY);
+        } else {
+            edit.shape->setLocation(edit.oldX, edit.oldY);
+        }
+        break;
+    case COLOR:
+        edit.shape->setColor(forward ? edit.newColor : edit.oldColor);
+        break;
+    case INSERT: case REMOVE:
+        if (forward == (edit.kind == INSERT)) {
+            shapes.insert(edit.from, edit.shape);
+        } else {
+            shapes.remove(edit.from);
+        }
+        break;
+    case REORDER:
+        shapes.moveTo(edit.shape, forward ? edit.to : edit.from);
+        break;
+    }
+}
+
+void EditJournal::discard(Edit & edit, bool done) {
+    if ((done && edit.kind == REMOVE) || (!done && edit.kind == INSERT)) {
+        delete edit.shape;
+    }
+    usage -= edit.bytes;
+}
+
+void EditJournal::trim() {
+    while (usage > budget && undoStack.size() > 1) {
+        discard(undoStack.front(), true);
+        undoStack.pop_front();
+    }
+}
+
+int EditJournal::indexOf(Shape *sp) const {
+    for (int i = 0; i < shapes.size(); i++) {
+        if (shapes[i] == sp) return i;
+    }
+    return -1;
+}
+
+// Successive moves of the shape on top of the stack extend its record
+void EditJournal::recordLocation(Shape *sp, GPoint old) {
+    GPoint now = sp->getLocation();
+    if (coalescing && undoStack.back().kind == LOCATION
+                   && undoStack.back().shape == sp) {
+        undoStack.back().newX = now.getX();
+        undoStack.back().newY = now.getY();
+        return;
+    }
+    Edit edit = { LOCATION, sp, old.getX(), old.getY(), now.getX(), now.getY(),
+                  "", "", 0, 0, 0 };
+    record(std::move(edit));
+    coalescing = true;
+}
+
+// A reorder that left the shape where it was is not a step
+void EditJournal::recordReorder(Shape *sp, int from) {
+    int to = indexOf(sp);
+    if (from != to) {
+        Edit edit = { REORDER, sp, 0, 0, 0, 0, "", "", from, to, 0 };
+        record(std::move(edit));
+    }
+    coalescing = false;
+}
@@ -0,0 +1,142 @@
+/*
+* File: journal.h
+* ---------------
+* This file defines an EditJournal class that makes the edits to a
+* ShapeList undoable by recording how to reverse each one.
+*/
+#ifndef _journal_h
+#define _journal_h
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+#include "shapelist.h"
+/*
+* Class: EditJournal
+* ------------------
+* Performs edits on a ShapeList and records, for each one, just enough to
+* reverse and repeat it: the old and new location of a moved shape, the
+* old and new color of a recolored one, or the positions involved in an
+* insertion, removal or reorder. Undo and redo therefore cost time and
+* memory proportional to the edit, not to the scene.
+*
+* Successive moves of one shape are coalesced into a single step until
+* checkpoint is called or a different edit is made, so an entire drag is
+* undone at once. The records are kept within a memory budget by
+* discarding the oldest steps.
+*
+* A shape removed through the journal is owned by the journal until the
+* removal is undone, and is deleted when the record of the removal is
+* discarded. Likewise, an added shape whose addition has been undone is
+* deleted when it can no longer be redone. Shapes edited through the
+* journal must be removed from the list through it as well.
+*/
+class EditJournal {
+public:
+/*
+* Constructor: EditJournal
+* Usage: EditJournal journal(shapes);
+* -----------------------------------
+* Creates an empty journal for shapes, with a memory budget of one
+* megabyte.
+*/
+explicit EditJournal(ShapeList & shapes);
+~EditJournal();
+EditJournal(const EditJournal &) = delete;
+EditJournal & operator=(const EditJournal &) = delete;
+/*
+* Methods: move, setLocation, setColor
+* Usage: journal.move(sp, dx, dy);
+* journal.setLocation(sp, x, y);
+* journal.setColor(sp, color);
+* ----------------------------
+* Call the method of the same name on sp and record the change.
+*/
+void move(Shape *sp, double dx, double dy);
+void setLocation(Shape *sp, double x, double y);
+void setColor(Shape *sp, const std::string & color);
+/*
+* Methods: add, remove
+* Usage: journal.add(sp);
+* journal.remove(sp);
+* -------------------
+* Add sp to the front of the list, or remove it from the list, and record
+* the change. The method remove signals an error if sp is not in the list.
+*/
+void add(Shape *sp);
+void remove(Shape *sp);
+/*
+* Methods: moveToFront, moveToBack, moveForward, moveBackward
+* Usage: journal.moveToFront(sp);
+* -------------------------------
+* Call the ShapeList method of the same name and record the change.
+*/
+void moveToFront(Shape *sp);
+void moveToBack(Shape *sp);
+void moveForward(Shape *sp);
+void moveBackward(Shape *sp);
+/*
+* Method: checkpoint
+* Usage: journal.checkpoint();
+* ----------------------------
+* Ends the current step, so that the next move is undone separately. An
+* editor calls this when the mouse button is released.
+*/
+void checkpoint();
+/*
+* Methods: undo, redo
+* Usage: if (journal.canUndo()) journal.undo();
+* ---------------------------------------------
+* Reverse the most recent step, or repeat the most recently undone one.
+* Each returns false, and does nothing, if there is no such step. Making
+* a new edit discards the steps that could have been redone.
+*/
+bool undo();
+bool redo();
+bool canUndo() const;
+bool canRedo() const;
+int getUndoCount() const;
+int getRedoCount() const;
+/*
+* Methods: setMemoryBudget, getMemoryBudget, getMemoryUsage
+* Usage: journal.setMemoryBudget(bytes);
+* --------------------------------------
+* Limit the memory used by the records, including removed shapes kept
+* for undo. When an edit exceeds the budget, the oldest steps are
+* discarded, but the most recent step is always kept.
+*/
+void setMemoryBudget(size_t bytes);
+size_t getMemoryBudget() const;
+size_t getMemoryUsage() const;
+/*
+* Method: clear
+* Usage: journal.clear();
+* -----------------------
+* Discards every step, deleting the shapes the journal owns.
+*/
+void clear();
+private:
+enum Kind { LOCATION, COLOR, INSERT, REMOVE, REORDER };
+struct Edit {
+Kind kind;
+Shape *shape;
+double oldX, oldY, newX, newY;
+std::string oldColor, newColor;
+int from, to;                 // List positions for the other kinds
+size_t bytes;
+};
+void record(Edit && edit);
+void apply(const Edit & edit, bool forward);
+void discard(Edit & edit, bool done);
+void trim();
+void recordLocation(Shape *sp, GPoint old);
+void recordReorder(Shape *sp, int from);
+int indexOf(Shape *sp) const;
+ShapeList & shapes;
+std::deque<Edit> undoStack;
+std::vector<Edit> redoStack;
+size_t budget;
+size_t usage;
+bool coalescing;
+};
+#endif
@@ -0,0 +1,109 @@
+/*
+* File: parallel.h
+* ----------------
+* This file defines parallelFor and parallelSort, which divide the work of
+* a loop or a sort among several threads.
+*/
+#ifndef _parallel_h
+#define _parallel_h
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+/*
+* Function: getDefaultThreadCount
+* Usage: int n = getDefaultThreadCount();
+* ---------------------------------------
+* Returns the number of threads the hardware can run at once, or 1 if it
+* is not known.
+*/
+inline int getDefaultThreadCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return (n == 0) ? 1 : (int) n;
+}
+/*
+* Function: parallelFor
+* Usage: parallelFor(count, threadCount, [&](int begin, int end) { ... });
+* -----------------------------------------------------------------------
+* Calls fn on consecutive ranges [begin, end) that together cover 0 up to
+* count, using at most threadCount threads, one of which is the calling
+* thread. A threadCount of 0 means getDefaultThreadCount(). No range is
+* shorter than minGrain unless count is, so short loops run entirely on
+* the calling thread. If fn throws, the first exception is rethrown once
+* every thread has finished.
+*/
+template <typename Function>
+void parallelFor(int count, int threadCount, Function fn, int minGrain = 4096) {
+    if (count <= 0) return;
+    if (threadCount <= 0) threadCount = getDefaultThreadCount();
+    int parts = std::max(1, std::min(threadCount, count / std::max(1, minGrain)));
+    if (parts == 1) {
+        fn(0, count);
+        return;
+    }
+    std::vector<std::exception_ptr> errors(parts);
+    std::vector<std::thread> workers;
+    auto run = [&](int part) {
+        int begin = (int) ((long long) count * part / parts);
+        int end = (int) ((long long) count * (part + 1) / parts);
+        try {
+            fn(begin, end);
+        } catch (...) {
+            errors[part] = std::current_exception();
+        }
+    };
+    for (int part = 1; part < parts; part++) {
+        workers.emplace_back(run, part);
+    }
+    run(0);
+    for (std::thread & worker : workers) {
+        worker.join();
+    }
+    for (std::exception_ptr & error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+/*
+* Function: parallelSort
+* Usage: parallelSort(v.begin(), v.end(), comp, threadCount);
+* -----------------------------------------------------------
+* Sorts a random-access range as std::sort does, by sorting up to
+* threadCount blocks at once and then merging them in pairs, with the
+* merges of each round also running in parallel.
+*/
+template <typename Iterator, typename Compare>
+void parallelSort(Iterator first, Iterator last, Compare comp,
+                  int threadCount = 0) {
+    const int MIN_BLOCK = 1 << 14;
+    int count = (int) (last - first);
+    if (threadCount <= 0) threadCount = getDefaultThreadCount();
+    int blocks = std::max(1, std::min(threadCount, count / MIN_BLOCK));
+    if (blocks == 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+    std::vector<int> bounds(blocks + 1);
+    for (int b = 0; b <= blocks; b++) {
+        bounds[b] = (int) ((long long) count * b / blocks);
+    }
+    parallelFor(blocks, blocks, [&](int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            std::sort(first + bounds[b], first + bounds[b + 1], comp);
+        }
+    }, 1);
+    for (int width = 1; width < blocks; width *= 2) {
+        int pairs = (blocks + 2 * width - 1) / (2 * width);
+        parallelFor(pairs, pairs, [&](int begin, int end) {
+            for (int p = begin; p < end; p++) {
+                int lo = 2 * width * p;
+                int mid = std::min(lo + width, blocks);
+                int hi = std::min(lo + 2 * width, blocks);
+                if (mid < hi) {
+                    std::inplace_merge(first + bounds[lo], first + bounds[mid],
+                                       first + bounds[hi], comp);
+                }
+            }
+        }, 1);
+    }
+}
+#endif
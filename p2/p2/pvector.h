@@ -0,0 +1,391 @@
+/*
+ * File: pvector.h
+ * ---------------
+ * This file exports the PVector class, a persistent variant of Vector
+ * whose copies share storage until one of them is modified.
+ */
+
+#ifndef _pvector_h
+#define _pvector_h
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Class: PVector<ValueType>
+ * -------------------------
+ * This class stores an ordered list of values, like Vector, but copying a
+ * PVector takes constant time however many elements it holds.  The copy
+ * and the original share their elements, and a modification copies only
+ * the small chunk of elements it touches, so a program can keep many
+ * versions of a large list at little cost.  Elements are read through
+ * get or const selection; they are changed only through set.
+ */
+
+template <typename ValueType>
+class PVector {
+
+public:
+
+/*
+ * Constructor: PVector
+ * Usage: PVector<ValueType> vec;
+ * ------------------------------
+ * Initializes a new empty vector.  Copies made with the copy constructor
+ * or assignment operator take constant time.
+ */
+
+   PVector();
+
+/*
+ * Methods: size, isEmpty, clear
+ * Usage: int nElems = vec.size();
+ * -------------------------------
+ * These methods behave as they do for Vector.
+ */
+
+   int size() const;
+   bool isEmpty() const;
+   void clear();
+
+/*
+ * Methods: get, set
+ * Usage: ValueType val = vec.get(index);
+ *        vec.set(index, value);
+ * -------------------------------------
+ * Read or replace the element at the specified index.  Both signal an
+ * error if the index is outside the vector.  The method set copies the
+ * chunk holding the element if the chunk is shared with another vector.
+ */
+
+   const ValueType & get(int index) const;
+   void set(int index, const ValueType & value);
+
+/*
+ * Methods: insert, remove, add, push_back
+ * Usage: vec.insert(index, value);
+ *        vec.remove(index);
+ *        vec.add(value);
+ * -------------------------------
+ * These methods behave as they do for Vector, but shift only the elements
+ * of one chunk, so they take time proportional to the chunk size plus the
+ * number of chunks rather than to the number of elements.
+ */
+
+   void insert(int index, ValueType value);
+   void remove(int index);
+   void add(ValueType value);
+   void push_back(ValueType value);
+
+/*
+ * Operator: []
+ * Usage: vec[index]
+ * -----------------
+ * Selects the element at the specified index for reading.  Signals an
+ * error if the index is outside the vector.
+ */
+
+   const ValueType & operator[](int index) const;
+
+/*
+ * Method: sharesChunks
+ * Usage: if (vec.sharesChunks(other)) ...
+ * ---------------------------------------
+ * Returns true if any storage is shared with other, which is useful for
+ * verifying that a snapshot has not been copied.
+ */
+
+   bool sharesChunks(const PVector & other) const;
+
+/* Private section */
+
+/**********************************************************************/
+/* Note: Everything below this point in the file is logically part    */
+/* of the implementation and should not be of interest to clients.    */
+/**********************************************************************/
+
+/*
+ * Implementation notes: PVector data structure
+ * --------------------------------------------
+ * The elements are divided into chunks of at most CHUNK_SIZE elements,
+ * and the vector holds a shared pointer to a table of shared pointers to
+ * the chunks.  Copying the vector copies only the pointer to the table.
+ * Before a modification, the vector copies the table if another vector
+ * refers to it, and then the chunk to be modified if another table refers
+ * to it, so exactly the storage being changed is duplicated.  The table
+ * keeps the index of the first element of every chunk, which lets get
+ * find the chunk for an index by binary search.
+ */
+
+private:
+
+   static const int CHUNK_SIZE = 64;
+
+   struct Chunk {
+      std::vector<ValueType> elements;
+   };
+
+   struct Table {
+      std::vector<std::shared_ptr<Chunk> > chunks;
+      std::vector<int> starts;    /* Index of the first element of each */
+   };
+
+   std::shared_ptr<Table> table;  /* NULL while the vector is empty      */
+   int count;
+
+   Table & mutableTable();
+   Chunk & mutableChunk(int c);
+   int findChunk(int index) const;
+   void updateStarts(int c);
+
+/*
+ * Iterator support
+ * ----------------
+ * The iterator walks the chunks in order and yields const references, so
+ * range-based for loops work without copying any storage.
+ */
+
+public:
+
+   class iterator {
+
+   private:
+      const Table *tp;
+      int chunk;
+      int index;
+
+   public:
+
+      typedef std::forward_iterator_tag iterator_category;
+      typedef ValueType value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const ValueType *pointer;
+      typedef const ValueType & reference;
+
+      iterator() : tp(NULL), chunk(0), index(0) {
+      }
+
+      iterator(const Table *tp, int chunk) : tp(tp), chunk(chunk), index(0) {
+      }
+
+      iterator & operator++() {
+         if (++index == (int) tp->chunks[chunk]->elements.size()) {
+            chunk++;
+            index = 0;
+         }
+         return *this;
+      }
+
+      iterator operator++(int) {
+         iterator copy(*this);
+         operator++();
+         return copy;
+      }
+
+      bool operator==(const iterator & rhs) const {
+         return chunk == rhs.chunk && index == rhs.index;
+      }
+
+      bool operator!=(const iterator & rhs) const {
+         return !(*this == rhs);
+      }
+
+      const ValueType & operator*() const {
+         return tp->chunks[chunk]->elements[index];
+      }
+
+      const ValueType *operator->() const {
+         return &**this;
+      }
+
+   };
+
+   iterator begin() const {
+      return iterator(table.get(), 0);
+   }
+
+   iterator end() const {
+      return iterator(table.get(), table ? (int) table->chunks.size() : 0);
+   }
+
+};
+
+extern void error(std::string msg);
+
+template <typename ValueType>
+PVector<ValueType>::PVector() {
+   count = 0;
+}
+
+template <typename ValueType>
+int PVector<ValueType>::size() const {
+   return count;
+}
+
+template <typename ValueType>
+bool PVector<ValueType>::isEmpty() const {
+   return count == 0;
+}
+
+template <typename ValueType>
+void PVector<ValueType>::clear() {
+   table.reset();
+   count = 0;
+}
+
+template <typename ValueType>
+const ValueType & PVector<ValueType>::get(int index) const {
+   if (index < 0 || index >= count) error("get: index out of range");
+   int c = findChunk(index);
+   return table->chunks[c]->elements[index - table->starts[c]];
+}
+
+template <typename ValueType>
+void PVector<ValueType>::set(int index, const ValueType & value) {
+   if (index < 0 || index >= count) error("set: index out of range");
+   int c = findChunk(index);
+   mutableChunk(c).elements[index - table->starts[c]] = value;
+}
+
+/*
+ * Implementation notes: insert, remove
+ * ------------------------------------
+ * A chunk that grows past CHUNK_SIZE is split in half, and a chunk that
+ * shrinks below a quarter of CHUNK_SIZE is merged into its successor if
+ * the two fit in one chunk, so chunks stay large enough that the table
+ * remains small.
+ */
+
+template <typename ValueType>
+void PVector<ValueType>::insert(int index, ValueType value) {
+   if (index < 0 || index > count) error("insert: index out of range");
+   if (!table) {
+      table = std::make_shared<Table>();
+      table->chunks.push_back(std::make_shared<Chunk>());
+      table->starts.push_back(0);
+   }
+   int c = findChunk(index);
+   Chunk & chunk = mutableChunk(c);
+   chunk.elements.insert(chunk.elements.begin() + (index - table->starts[c]),
+                         std::move(value));
+   if ((int) chunk.elements.size() > CHUNK_SIZE) {
+      std::shared_ptr<Chunk> tail = std::make_shared<Chunk>();
+      int half = (int) chunk.elements.size() / 2;
+      tail->elements.assign(std::make_move_iterator(chunk.elements.begin() + half),
+                            std::make_move_iterator(chunk.elements.end()));
+      chunk.elements.resize(half);
+      table->chunks.insert(table->chunks.begin() + c + 1, tail);
+      table->starts.insert(table->starts.begin() + c + 1, 0);
+   }
+   count++;
+   updateStarts(c);
+}
+
+template <typename ValueType>
+void PVector<ValueType>::remove(int index) {
+   if (index < 0 || index >= count) error("remove: index out of range");
+   int c = findChunk(index);
+   Chunk & chunk = mutableChunk(c);
+   chunk.elements.erase(chunk.elements.begin() + (index - table->starts[c]));
+   count--;
+   if (count == 0) {
+      table.reset();
+      return;
+   }
+   int size = (int) chunk.elements.size();
+   if (size == 0) {
+      table->chunks.erase(table->chunks.begin() + c);
+      table->starts.erase(table->starts.begin() + c);
+   } else if (size < CHUNK_SIZE / 4 && c + 1 < (int) table->chunks.size()
+              && size + (int) table->chunks[c + 1]->elements.size() <= CHUNK_SIZE) {
+      const std::vector<ValueType> & next = table->chunks[c + 1]->elements;
+      chunk.elements.insert(chunk.elements.end(), next.begin(), next.end());
+      table->chunks.erase(table->chunks.begin() + c + 1);
+      table->starts.erase(table->starts.begin() + c + 1);
+   }
+   updateStarts(std::max(0, c - 1));
+}
+
+template <typename ValueType>
+void PVector<ValueType>::add(ValueType value) {
+   insert(count, std::move(value));
+}
+
+template <typename ValueType>
+void PVector<ValueType>::push_back(ValueType value) {
+   insert(count, std::move(value));
+}
+
+template <typename ValueType>
+const ValueType & PVector<ValueType>::operator[](int index) const {
+   if (index < 0 || index >= count) error("Selection index out of range");
+   int c = findChunk(index);
+   return table->chunks[c]->elements[index - table->starts[c]];
+}
+
+template <typename ValueType>
+bool PVector<ValueType>::sharesChunks(const PVector & other) const {
+   if (!table || !other.table) return false;
+   if (table == other.table) return true;
+   for (const std::shared_ptr<Chunk> & chunk : table->chunks) {
+      for (const std::shared_ptr<Chunk> & theirs : other.table->chunks) {
+         if (chunk == theirs) return true;
+      }
+   }
+   return false;
+}
+
+/*
+ * Implementation notes: mutableTable, mutableChunk
+ * ------------------------------------------------
+ * The reference count is read without ordering, so when another thread
+ * has just released the last other reference, the acquire fence is what
+ * orders its final reads of the storage before the writes made here.
+ */
+
+template <typename ValueType>
+typename PVector<ValueType>::Table & PVector<ValueType>::mutableTable() {
+   if (table.use_count() > 1) {
+      table = std::make_shared<Table>(*table);
+   } else {
+      std::atomic_thread_fence(std::memory_order_acquire);
+   }
+   return *table;
+}
+
+template <typename ValueType>
+typename PVector<ValueType>::Chunk & PVector<ValueType>::mutableChunk(int c) {
+   Table & t = mutableTable();
+   if (t.chunks[c].use_count() > 1) {
+      t.chunks[c] = std::make_shared<Chunk>(*t.chunks[c]);
+   } else {
+      std::atomic_thread_fence(std::memory_order_acquire);
+   }
+   return *t.chunks[c];
+}
+
+/* Returns the last chunk starting at or before index */
+template <typename ValueType>
+int PVector<ValueType>::findChunk(int index) const {
+   const std::vector<int> & starts = table->starts;
+   return (int) (std::upper_bound(starts.begin(), starts.end(), index)
+                 - starts.begin()) - 1;
+}
+
+template <typename ValueType>
+void PVector<ValueType>::updateStarts(int c) {
+   std::vector<int> & starts = table->starts;
+   int start = (c == 0) ? 0 : starts[c - 1]
+                         + (int) table->chunks[c - 1]->elements.size();
+   for (int i = c; i < (int) starts.size(); i++) {
+      starts[i] = start;
+      start += (int) table->chunks[i]->elements.size();
+   }
+}
+
+#endif
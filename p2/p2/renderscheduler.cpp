@@ -0,0 +1,183 @@
+/*
+ * File: renderscheduler.cpp
+ * -------------------------
+ * This file implements the RenderScheduler class.
+ */
+
+#include "renderscheduler.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+/*
+ * Implementation notes: RenderScheduler
+ * -------------------------------------
+ * The publishing thread and the render thread share a single slot that
+ * holds the newest undrawn snapshot.  Publishing overwrites the slot, and
+ * the render thread empties it only when a frame actually starts, so any
+ * snapshot published while the render thread waits for its start time is
+ * folded into that frame.  Snapshots are moved out of the slot and
+ * destroyed outside the lock, since releasing one may free the copies of
+ * many shapes.  An exception raised while drawing a frame is caught on
+ * the render thread, where it would otherwise end the process, and kept
+ * in failure until a call from the owning thread rethrows it.
+ */
+
+RenderScheduler::RenderScheduler(GWindow & gw, ShapeList & shapes,
+                                 double framesPerSecond, FramePacing pacing)
+    : gw(gw), shapes(shapes) {
+    chrono::duration<double> seconds(1 / framesPerSecond);
+    if (!(framesPerSecond > 0) || seconds > Clock::duration::max()) {
+        throw runtime_error("RenderScheduler: Frame rate out of range");
+    }
+    publishedGeneration = 0;
+    // A rate too high for the clock still leaves one tick between frames
+    interval = max(chrono::duration_cast<Clock::duration>(seconds),
+                   Clock::duration(1));
+    origin = Clock::now();
+    lastStart = origin - interval;
+    this->pacing = pacing;
+    hasPending = false;
+    rendering = false;
+    stopping = false;
+    stats = FrameStats { 0, 0, 0, 0, 0, 0, 0 };
+    totalRenderMs = 0;
+    worker = thread(&RenderScheduler::renderLoop, this);
+    publish();
+}
+
+RenderScheduler::~RenderScheduler() {
+    shutDown();
+}
+
+void RenderScheduler::publish() {
+    if (shapes.getGeneration() == publishedGeneration) {
+        rethrowFailure();
+        return;
+    }
+    SceneSnapshot frozen = shapes.snapshot();
+    publishedGeneration = frozen.getGeneration();
+    {
+        lock_guard<mutex> guard(lock);
+        if (hasPending) stats.updatesCoalesced++;
+        stats.updatesPublished++;
+        swap(pending, frozen);
+        hasPending = true;
+    }
+    sceneReady.notify_one();
+    rethrowFailure();
+}
+
+void RenderScheduler::waitUntilIdle() {
+    {
+        unique_lock<mutex> guard(lock);
+        frameDone.wait(guard, [this] {
+            return stopping || (!hasPending && !rendering);
+        });
+    }
+    rethrowFailure();
+}
+
+void RenderScheduler::stop() {
+    shutDown();
+    rethrowFailure();
+}
+
+void RenderScheduler::shutDown() {
+    {
+        lock_guard<mutex> guard(lock);
+        if (stopping && !worker.joinable()) return;
+        stopping = true;
+    }
+    sceneReady.notify_one();
+    frameDone.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+void RenderScheduler::rethrowFailure() {
+    exception_ptr error;
+    {
+        lock_guard<mutex> guard(lock);
+        swap(error, failure);
+    }
+    if (error) rethrow_exception(error);
+}
+
+void RenderScheduler::setPacing(FramePacing pacing) {
+    lock_guard<mutex> guard(lock);
+    this->pacing = pacing;
+}
+
+FramePacing RenderScheduler::getPacing() const {
+    lock_guard<mutex> guard(lock);
+    return pacing;
+}
+
+FrameStats RenderScheduler::getStats() const {
+    lock_guard<mutex> guard(lock);
+    FrameStats result = stats;
+    if (stats.framesRendered > 0) {
+        result.averageRenderMs = totalRenderMs / stats.framesRendered;
+    }
+    return result;
+}
+
+/* Must be called with the lock held */
+RenderScheduler::Clock::time_point
+RenderScheduler::nextFrameStart(Clock::time_point now) const {
+    if (pacing == PACE_ON_DEMAND) return max(now, lastStart + interval);
+    Clock::duration elapsed = now - origin;
+    Clock::duration::rep ticks = (elapsed.count() + interval.count() - 1)
+                               / interval.count();
+    Clock::time_point tick = origin + ticks * interval;
+    // A frame never starts on the same tick as the previous one
+    return (tick <= lastStart) ? lastStart + interval : tick;
+}
+
+void RenderScheduler::renderLoop() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        sceneReady.wait(guard, [this] { return stopping || hasPending; });
+        if (stopping) break;
+        Clock::time_point start = nextFrameStart(Clock::now());
+        sceneReady.wait_until(guard, start, [this] { return stopping; });
+        if (stopping) break;
+        SceneSnapshot frame;
+        swap(frame, pending);
+        hasPending = false;
+        rendering = true;
+        lastStart = start;
+        guard.unlock();
+        Clock::time_point begin = Clock::now();
+        exception_ptr error;
+        try {
+            gw.clear();
+            frame.draw(gw);
+            gw.repaint();
+        } catch (...) {
+            error = current_exception();
+        }
+        Clock::duration took = Clock::now() - begin;
+        frame = SceneSnapshot();
+        guard.lock();
+        rendering = false;
+        if (error) {
+            if (!failure) failure = error;
+            frameDone.notify_all();
+            continue;
+        }
+        double ms = chrono::duration<double, milli>(took).count();
+        stats.framesRendered++;
+        totalRenderMs += ms;
+        stats.maxRenderMs = max(stats.maxRenderMs, ms);
+        if (took > interval) {
+            stats.framesLate++;
+            stats.framesDropped += took / interval;
+        }
+        frameDone.notify_all();
+    }
+    rendering = false;
+    frameDone.notify_all();
+}
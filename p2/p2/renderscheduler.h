@@ -0,0 +1,138 @@
+/*
+* File: renderscheduler.h
+* -----------------------
+* This file defines a RenderScheduler class that redraws a ShapeList in a
+* window on its own thread, at most once per frame, from snapshots of the
+* scene published by the thread that changes it.
+*/
+#ifndef _renderscheduler_h
+#define _renderscheduler_h
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include "gwindow.h"
+#include "shapelist.h"
+/*
+* Type: FramePacing
+* -----------------
+* Determines when a frame starts once the scene has changed. Under
+* PACE_FIXED_RATE, frames start only on a fixed grid of ticks one frame
+* interval apart, like a display refreshing at a constant rate. Under
+* PACE_ON_DEMAND, a frame starts as soon as the scene changes, provided a
+* full interval has passed since the previous frame started.
+*/
+enum FramePacing { PACE_FIXED_RATE, PACE_ON_DEMAND };
+/*
+* Type: FrameStats
+* ----------------
+* The counters kept by a RenderScheduler. A frame is late if drawing it
+* took longer than the frame interval, and every whole interval it
+* overran counts as one dropped frame, a refresh on which the window
+* could not show the latest scene. Coalesced updates are snapshots that
+* were replaced by a newer one before they could be drawn.
+*/
+struct FrameStats {
+uint64_t framesRendered;
+uint64_t framesLate;
+uint64_t framesDropped;
+uint64_t updatesPublished;
+uint64_t updatesCoalesced;
+double averageRenderMs;
+double maxRenderMs;
+};
+/*
+* Class: RenderScheduler
+* ----------------------
+* Draws a ShapeList in a GWindow on a dedicated thread. The thread that
+* owns the list calls publish after changing it, which takes a snapshot
+* and hands it over without waiting for the window. Snapshots published
+* faster than the frame rate replace one another, so a burst of changes
+* leads to one redraw of the final scene. No other thread may draw in the
+* window while the scheduler is running. If drawing a frame raises an
+* exception, such as a shape whose color is not defined, the frame is
+* abandoned, the render thread goes on to the next one, and the next call
+* to publish, waitUntilIdle or stop rethrows the exception.
+*/
+class RenderScheduler {
+public:
+/*
+* Constructor: RenderScheduler
+* Usage: RenderScheduler scheduler(gw, shapes);
+* RenderScheduler scheduler(gw, shapes, fps, pacing);
+* ---------------------------------------------------
+* Starts the render thread and publishes the current scene. The frame
+* rate defaults to 60 frames per second and the pacing to fixed rate. A
+* frame rate that is not positive, or too low for the clock to count,
+* signals an error.
+*/
+RenderScheduler(GWindow & gw, ShapeList & shapes,
+double framesPerSecond = 60,
+FramePacing pacing = PACE_FIXED_RATE);
+/*
+* Destructor: ~RenderScheduler
+* ----------------------------
+* Stops the render thread, discarding any scene not yet drawn and any
+* exception not yet rethrown.
+*/
+~RenderScheduler();
+RenderScheduler(const RenderScheduler &) = delete;
+RenderScheduler & operator=(const RenderScheduler &) = delete;
+/*
+* Method: publish
+* Usage: scheduler.publish();
+* ---------------------------
+* Schedules the list, as it is now, to be drawn on the next frame. The
+* call returns at once and does nothing if the list has not changed
+* since the last call. It must be made on the thread that changes the
+* list. If an earlier frame failed, the scene is still scheduled and the
+* exception that frame raised is rethrown.
+*/
+void publish();
+/*
+* Method: waitUntilIdle
+* Usage: scheduler.waitUntilIdle();
+* ---------------------------------
+* Waits until the most recently published scene has been drawn, and
+* rethrows the exception raised by any frame that failed.
+*/
+void waitUntilIdle();
+/*
+* Method: stop
+* Usage: scheduler.stop();
+* ------------------------
+* Stops the render thread after the frame in progress, if any, and
+* rethrows the exception raised by any frame that failed.
+*/
+void stop();
+void setPacing(FramePacing pacing);
+FramePacing getPacing() const;
+FrameStats getStats() const;
+private:
+typedef std::chrono::steady_clock Clock;
+void renderLoop();
+void shutDown();
+void rethrowFailure();
+Clock::time_point nextFrameStart(Clock::time_point now) const;
+GWindow & gw;
+ShapeList & shapes;
+uint64_t publishedGeneration;  // Touched only by the publishing thread
+Clock::duration interval;
+Clock::time_point origin;
+Clock::time_point lastStart;
+FramePacing pacing;
+SceneSnapshot pending;
+bool hasPending;
+bool rendering;
+bool stopping;
+FrameStats stats;
+double totalRenderMs;
+std::exception_ptr failure;
+mutable std::mutex lock;
+std::condition_variable sceneReady;
+std::condition_variable frameDone;
+std::thread worker;
+};
+#endif
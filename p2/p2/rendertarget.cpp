@@ -0,0 +1,125 @@
+/*
+ * File: rendertarget.cpp
+ * ----------------------
+ * This file implements the RenderTarget defaults and the WindowTarget and
+ * NullTarget classes.
+ */
+
+#include "rendertarget.h"
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+double RenderTarget::getPixelSize() const {
+    return 1;
+}
+
+void RenderTarget::drawPolyline(const double *coords, int count,
+                                double x, double y, bool closed) {
+    int edges = closed ? count : count - 1;
+    for (int k = 0; k < edges; k++) {
+        int m = (k + 1) % count;
+        drawLine(x + coords[2 * k], y + coords[2 * k + 1],
+                 x + coords[2 * m], y + coords[2 * m + 1]);
+    }
+}
+
+void RenderTarget::fillPolygon(const double *coords, int count,
+                               double x, double y, FillRule rule) {
+    if (count < 3) return;
+    EdgeTable table(coords, count, x, y);
+    int j0 = (int) floor(table.getTop());
+    int j1 = (int) ceil(table.getBottom());
+    for (int j = j0; j < j1; j++) {
+        table.scan(j + 0.5, rule, [this, j](double left, double right) {
+            double i0 = ceil(left - 0.5);
+            double i1 = ceil(right - 0.5);
+            if (i1 > i0) fillRect(i0, j, i1 - i0, 1);
+        });
+    }
+}
+
+void RenderTarget::fillRects(const GRectangle *rects, int count) {
+    for (int i = 0; i < count; i++) {
+        fillRect(rects[i].getX(), rects[i].getY(),
+                 rects[i].getWidth(), rects[i].getHeight());
+    }
+}
+
+WindowTarget::WindowTarget(GWindow & gw) : gw(gw) {
+}
+
+GRectangle WindowTarget::getViewport() const {
+    return GRectangle(0, 0, gw.getWidth(), gw.getHeight());
+}
+
+void WindowTarget::setColor(ColorId color) {
+    if (!color.isValid()) throw runtime_error("WindowTarget::setColor: Undefined color");
+    gw.setColor(color);
+}
+
+void WindowTarget::drawLine(double x0, double y0, double x1, double y1) {
+    gw.drawLine(x0, y0, x1, y1);
+}
+
+void WindowTarget::fillRect(double x, double y, double width, double height) {
+    gw.fillRect(x, y, width, height);
+}
+
+void WindowTarget::fillOval(double x, double y, double width, double height) {
+    gw.fillOval(x, y, width, height);
+}
+
+NullTarget::NullTarget(double width, double height) {
+    this->width = width;
+    this->height = height;
+    primitives = colorChanges = 0;
+}
+
+GRectangle NullTarget::getViewport() const {
+    return GRectangle(0, 0, width, height);
+}
+
+void NullTarget::setColor(ColorId color) {
+    if (!color.isValid()) throw runtime_error("NullTarget::setColor: Undefined color");
+    colorChanges++;
+}
+
+void NullTarget::drawLine(double, double, double, double) {
+    primitives++;
+}
+
+void NullTarget::fillRect(double, double, double, double) {
+    primitives++;
+}
+
+void NullTarget::fillOval(double, double, double, double) {
+    primitives++;
+}
+
+void NullTarget::drawPolyline(const double *, int count, double, double,
+                              bool closed) {
+    if (count > 1) primitives += closed ? count : count - 1;
+}
+
+void NullTarget::fillPolygon(const double *, int count, double, double,
+                             FillRule) {
+    if (count >= 3) primitives++;
+}
+
+void NullTarget::fillRects(const GRectangle *, int count) {
+    primitives += count;
+}
+
+uint64_t NullTarget::getPrimitiveCount() const {
+    return primitives;
+}
+
+uint64_t NullTarget::getColorChanges() const {
+    return colorChanges;
+}
+
+void NullTarget::resetCounts() {
+    primitives = colorChanges = 0;
+}
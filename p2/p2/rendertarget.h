@@ -0,0 +1,148 @@
+/*
+* File: rendertarget.h
+* --------------------
+* This file defines the RenderTarget interface that shapes draw on, an
+* adapter that draws on a GWindow, and a target that draws nothing.
+*/
+#ifndef _rendertarget_h
+#define _rendertarget_h
+#include <cstdint>
+#include "colortable.h"
+#include "gtypes.h"
+#include "gwindow.h"
+#include "scanline.h"
+/*
+* Class: RenderTarget
+* -------------------
+* A drawing surface with the primitives of GWindow: lines one pixel wide,
+* filled rectangles and ovals, and a current color. Shape::draw and
+* ShapeList::draw are written against this interface, so a scene can be
+* rendered on a window, into a Framebuffer, or anywhere else a subclass
+* sends the calls. The batch methods draw many primitives of one color in
+* a single call; their default implementations call the single ones, and
+* targets override them where a batch can be drawn more cheaply.
+*/
+class RenderTarget {
+public:
+virtual ~RenderTarget() {}
+/*
+* Method: getViewport
+* Usage: GRectangle visible = target.getViewport();
+* -------------------------------------------------
+* Returns the part of the scene the target shows, in scene coordinates.
+* Drawing outside it has no visible effect, so callers may skip shapes
+* that lie wholly outside it.
+*/
+virtual GRectangle getViewport() const = 0;
+/*
+* Method: getPixelSize
+* Usage: double size = target.getPixelSize();
+* -------------------------------------------
+* Returns the width of one pixel of the target in scene units. It is 1 by
+* default and differs only on targets that scale the scene, where callers
+* that reason in pixels must convert their sizes with it.
+*/
+virtual double getPixelSize() const;
+/*
+* Methods: setColor, drawLine, fillRect, fillOval
+* Usage: target.setColor(color);
+* target.drawLine(x0, y0, x1, y1);
+* target.fillRect(x, y, width, height);
+* target.fillOval(x, y, width, height);
+* -------------------------------------
+* Set the drawing color, which signals an error if it is not valid, and
+* draw with the same geometry as the GWindow methods of the same names.
+*/
+virtual void setColor(ColorId color) = 0;
+virtual void drawLine(double x0, double y0, double x1, double y1) = 0;
+virtual void fillRect(double x, double y, double width, double height) = 0;
+virtual void fillOval(double x, double y, double width, double height) = 0;
+/*
+* Method: drawPolyline
+* Usage: target.drawPolyline(coords, count, x, y, closed);
+* --------------------------------------------------------
+* Draws lines through the count vertices given as x0, y0, x1, y1, ...
+* relative to the point (x, y), and back to the first if closed is true.
+*/
+virtual void drawPolyline(const double *coords, int count, double x, double y,
+bool closed);
+/*
+* Method: fillPolygon
+* Usage: target.fillPolygon(coords, count, x, y, rule);
+* -----------------------------------------------------
+* Fills the polygon whose count vertices are given as for drawPolyline.
+* By default the polygon is filled as one rectangle per span of each
+* pixel row, covering the pixels whose centers lie inside it.
+*/
+virtual void fillPolygon(const double *coords, int count, double x, double y,
+FillRule rule = NON_ZERO);
+/*
+* Method: fillRects
+* Usage: target.fillRects(rects, count);
+* --------------------------------------
+* Fills count rectangles in the current color.
+*/
+virtual void fillRects(const GRectangle *rects, int count);
+};
+/*
+* Class: WindowTarget
+* -------------------
+* A RenderTarget that passes every call on to a GWindow. Its viewport is
+* the window, with the scene origin at its top-left corner.
+*/
+class WindowTarget : public RenderTarget {
+public:
+explicit WindowTarget(GWindow & gw);
+virtual GRectangle getViewport() const;
+virtual void setColor(ColorId color);
+virtual void drawLine(double x0, double y0, double x1, double y1);
+virtual void fillRect(double x, double y, double width, double height);
+virtual void fillOval(double x, double y, double width, double height);
+private:
+GWindow & gw;
+};
+/*
+* Class: NullTarget
+* -----------------
+* A RenderTarget that draws nothing and only counts the primitives it is
+* asked to draw, a batch counting as one per element. Rendering a scene on
+* it measures the cost of traversing the scene and deciding what to draw,
+* apart from the cost of drawing.
+*/
+class NullTarget : public RenderTarget {
+public:
+/*
+* Constructor: NullTarget
+* Usage: NullTarget target(width, height);
+* ----------------------------------------
+* Creates a target whose viewport is a width by height window at the
+* scene origin.
+*/
+NullTarget(double width, double height);
+virtual GRectangle getViewport() const;
+virtual void setColor(ColorId color);
+virtual void drawLine(double x0, double y0, double x1, double y1);
+virtual void fillRect(double x, double y, double width, double height);
+virtual void fillOval(double x, double y, double width, double height);
+virtual void drawPolyline(const double *coords, int count, double x, double y,
+bool closed);
+virtual void fillPolygon(const double *coords, int count, double x, double y,
+FillRule rule = NON_ZERO);
+virtual void fillRects(const GRectangle *rects, int count);
+/*
+* Methods: getPrimitiveCount, getColorChanges, resetCounts
+* Usage: uint64_t drawn = target.getPrimitiveCount();
+* ---------------------------------------------------
+* Report the primitives drawn and colors set since the target was created
+* or the counts were last reset.
+*/
+uint64_t getPrimitiveCount() const;
+uint64_t getColorChanges() const;
+void resetCounts();
+private:
+double width;
+double height;
+uint64_t primitives;
+uint64_t colorChanges;
+};
+#endif
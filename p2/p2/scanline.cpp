@@ -0,0 +1,128 @@
+#include "scanline.h"
+#include <cmath>
+
+using namespace std;
+
+// Implementation notes: EdgeTable class
+
+EdgeTable::EdgeTable(const double *coords, int count, double dx, double dy) {
+    next = 0;
+    top = bottom = 0;
+    for (int k = 0; k < count; k++) {
+        double x0 = coords[2 * k] + dx;
+        double y0 = coords[2 * k + 1] + dy;
+        int m = (k + 1) % count;
+        double x1 = coords[2 * m] + dx;
+        double y1 = coords[2 * m + 1] + dy;
+        if (k == 0) {
+            top = bottom = y0;
+        }
+        top = min(top, y0);
+        bottom = max(bottom, y0);
+        if (y0 == y1) continue;
+        Edge e;
+        e.direction = (y1 > y0) ? 1 : -1;
+        if (y1 < y0) {
+            swap(x0, x1);
+            swap(y0, y1);
+        }
+        e.top = y0;
+        e.bottom = y1;
+        e.x = x0;
+        e.slope = (x1 - x0) / (y1 - y0);
+        edges.push_back(e);
+    }
+    sort(edges.begin(), edges.end(), [](const Edge & a, const Edge & b) {
+        return a.top < b.top;
+    });
+}
+
+double EdgeTable::getTop() const {
+    return top;
+}
+
+double EdgeTable::getBottom() const {
+    return bottom;
+}
+
+// Implementation notes: EdgeBuckets class
+//
+// The number of bands grows with the square root of the edge count, which
+// keeps both the table and the average band short.  The table is built in
+// two passes, counting and then filling, so the edge lists can share one
+// array.
+
+EdgeBuckets::EdgeBuckets() {
+    clear();
+}
+
+void EdgeBuckets::clear() {
+    built = false;
+    top = 0;
+    scale = 0;
+    bandCount = 0;
+    offsets.clear();
+    indices.clear();
+}
+
+bool EdgeBuckets::isBuilt() const {
+    return built;
+}
+
+size_t EdgeBuckets::getHeapUsage() const {
+    return (offsets.capacity() + indices.capacity()) * sizeof(int);
+}
+
+void EdgeBuckets::build(const double *coords, int count, bool closed,
+                        double margin) {
+    clear();
+    built = true;
+    int edgeCount = closed ? count : count - 1;
+    if (edgeCount <= 0) return;
+    double bottom = top = coords[1];
+    for (int k = 1; k < count; k++) {
+        top = min(top, coords[2 * k + 1]);
+        bottom = max(bottom, coords[2 * k + 1]);
+    }
+    top -= margin;
+    bottom += margin;
+    bandCount = max(1, (int) sqrt((double) edgeCount));
+    double height = bottom - top;
+    scale = (height > 0) ? bandCount / height : 0;
+    offsets.assign(bandCount + 1, 0);
+    auto bands = [&](int k, int & first, int & last) {
+        int m = (k + 1) % count;
+        double y0 = min(coords[2 * k + 1], coords[2 * m + 1]) - margin;
+        double y1 = max(coords[2 * k + 1], coords[2 * m + 1]) + margin;
+        first = max(0, min(bandCount - 1, (int) ((y0 - top) * scale)));
+        last = max(0, min(bandCount - 1, (int) ((y1 - top) * scale)));
+    };
+    int first, last;
+    for (int k = 0; k < edgeCount; k++) {
+        bands(k, first, last);
+        for (int b = first; b <= last; b++) {
+            offsets[b + 1]++;
+        }
+    }
+    for (int b = 0; b < bandCount; b++) {
+        offsets[b + 1] += offsets[b];
+    }
+    indices.resize(offsets[bandCount]);
+    vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (int k = 0; k < edgeCount; k++) {
+        bands(k, first, last);
+        for (int b = first; b <= last; b++) {
+            indices[fill[b]++] = k;
+        }
+    }
+}
+
+bool EdgeBuckets::find(double y, const int *& first, const int *& last) const {
+    if (bandCount == 0) return false;
+    double band = (y - top) * scale;
+    if (band < 0 || band > bandCount) return false;
+    int b = min(bandCount - 1, (int) band);
+    first = indices.data() + offsets[b];
+    last = indices.data() + offsets[b + 1];
+    return first != last;
+}
@@ -0,0 +1,164 @@
+/*
+ * File: scanline.h
+ * ----------------
+ * This file exports the edge structures shared by the polygon shapes and
+ * the rasterizers: an active-edge table that produces the spans a polygon
+ * covers on successive scanlines, and an index that buckets edges by y so
+ * that point queries against large outlines examine only nearby edges.
+ */
+
+#ifndef _scanline_h
+#define _scanline_h
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/*
+ * Type: FillRule
+ * --------------
+ * Determines which points a self-intersecting polygon contains.  Under
+ * EVEN_ODD, a point is inside if a ray from it crosses the outline an odd
+ * number of times; under NON_ZERO, if the outline winds around it.
+ */
+
+enum FillRule { EVEN_ODD, NON_ZERO };
+
+/*
+ * Class: EdgeTable
+ * ----------------
+ * Scan-converts a closed polygon.  The constructor sorts the non-
+ * horizontal edges by their top; each call to scan then updates the list
+ * of active edges incrementally, so the calls must be made in order of
+ * increasing y.  The coordinates are given as x0, y0, x1, y1, ... and are
+ * offset by (dx, dy).
+ */
+
+class EdgeTable {
+
+public:
+
+   EdgeTable(const double *coords, int count, double dx, double dy);
+
+   double getTop() const;
+   double getBottom() const;
+
+/*
+ * Method: scan
+ * Usage: table.scan(y, rule, fn);
+ * -------------------------------
+ * Calls fn(left, right) for each interval of the horizontal line at y
+ * that lies inside the polygon, from left to right.
+ */
+
+   template <typename SpanFn>
+   void scan(double y, FillRule rule, SpanFn fn);
+
+private:
+
+   struct Edge {
+      double top, bottom;         /* Vertical extent, top inclusive    */
+      double x, slope;            /* x at top and dx/dy                */
+      int direction;              /* +1 if the edge runs downward      */
+   };
+
+   std::vector<Edge> edges;
+   std::vector<int> active;
+   std::vector<std::pair<double, int> > crossings;
+   size_t next;
+   double top, bottom;
+
+};
+
+/*
+ * Class: EdgeBuckets
+ * ------------------
+ * Divides the vertical extent of an outline into equal bands and records,
+ * for every band, the edges that come within margin of it.  Edge k joins
+ * vertex k to vertex k + 1, wrapping to vertex 0 if the outline is
+ * closed.  The edge lists are stored contiguously, band after band.
+ */
+
+class EdgeBuckets {
+
+public:
+
+   EdgeBuckets();
+
+   void build(const double *coords, int count, bool closed, double margin);
+   void clear();
+   bool isBuilt() const;
+
+/*
+ * Method: find
+ * Usage: if (buckets.find(y, first, last)) ...
+ * --------------------------------------------
+ * Sets [first, last) to the indices of the edges that may lie within
+ * margin of the horizontal line at y.  Returns false if no edge can.
+ */
+
+   bool find(double y, const int *& first, const int *& last) const;
+
+/*
+ * Method: getHeapUsage
+ * Usage: size_t bytes = buckets.getHeapUsage();
+ * ---------------------------------------------
+ * Returns the bytes allocated for the index, not counting the object.
+ */
+
+   size_t getHeapUsage() const;
+
+private:
+
+   bool built;
+   double top;
+   double scale;                  /* Bands per unit of y               */
+   int bandCount;
+   std::vector<int> offsets;
+   std::vector<int> indices;
+
+};
+
+/*
+ * Implementation notes: EdgeTable::scan
+ * -------------------------------------
+ * Edges whose top has been reached are appended to the active list and
+ * edges whose bottom has been passed are dropped from it.  The crossings
+ * of the remaining edges with the scanline are sorted, and the spans
+ * between them are reported according to the fill rule.
+ */
+
+template <typename SpanFn>
+void EdgeTable::scan(double y, FillRule rule, SpanFn fn) {
+   while (next < edges.size() && edges[next].top <= y) {
+      active.push_back((int) next++);
+   }
+   crossings.clear();
+   size_t kept = 0;
+   for (size_t k = 0; k < active.size(); k++) {
+      const Edge & e = edges[active[k]];
+      if (e.bottom <= y) continue;
+      active[kept++] = active[k];
+      if (e.top <= y) {
+         crossings.push_back(std::make_pair(e.x + (y - e.top) * e.slope,
+                                            e.direction));
+      }
+   }
+   active.resize(kept);
+   std::sort(crossings.begin(), crossings.end());
+   int winding = 0;
+   double left = 0;
+   for (size_t k = 0; k < crossings.size(); k++) {
+      bool wasInside = (rule == EVEN_ODD) ? (k % 2 == 1) : winding != 0;
+      winding += crossings[k].second;
+      bool isInside = (rule == EVEN_ODD) ? (k % 2 == 0) : winding != 0;
+      if (!wasInside && isInside) {
+         left = crossings[k].first;
+      } else if (wasInside && !isInside && crossings[k].first > left) {
+         fn(left, crossings[k].first);
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,446 @@
+/*
+ * File: scenedelta.cpp
+ * --------------------
+ * This file implements the SceneEncoder and SceneReplica classes.
+ */
+
+#include "scenedelta.h"
+#include "bytestream.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+/*
+ * Implementation notes: delta format
+ * ----------------------------------
+ * A delta is a sequence of operations, each an opcode byte followed by
+ * its operands, and ends with an OP_END record holding the shape count
+ * and checksum.  Shapes are named by the ids the encoder assigned them
+ * and sent in the form written by Shape::encode, which begins with a
+ * fixed header of the type, location and color.  Comparing the header
+ * and the rest of the old and new encodings separately tells the encoder
+ * whether a change can be sent as a move or a recolor.  A delta begins
+ * with no header of its own, so deltas can be concatenated.
+ */
+
+namespace {
+
+enum Op {
+    OP_ADD = 1,                    // id, index, encoding
+    OP_REMOVE,                     // id
+    OP_MOVE,                       // id, x, y
+    OP_COLOR,                      // id, color
+    OP_REPLACE,                    // id, encoding
+    OP_REORDER,                    // from, to
+    OP_CLEAR,
+    OP_END                         // shape count, checksum
+};
+
+// The encoding header is the type byte, x and y, and the color string
+const size_t LOCATION_OFFSET = 1;
+const size_t COLOR_OFFSET = 17;
+
+size_t headerSize(const string & encoding) {
+    ByteReader in(encoding.data() + COLOR_OFFSET,
+                  encoding.size() - COLOR_OFFSET);
+    return COLOR_OFFSET + 4 + in.readU32();
+}
+
+uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+// FNV-1a over the id and encoding, finished with a strong mixer so that
+// the hashes of similar shapes spread out.
+uint64_t shapeHash(uint32_t id, const string & encoding) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < 4; i++) {
+        hash = (hash ^ ((id >> (8 * i)) & 0xFF)) * 1099511628211ULL;
+    }
+    for (char ch : encoding) {
+        hash = (hash ^ (unsigned char) ch) * 1099511628211ULL;
+    }
+    return mix(hash);
+}
+
+// The term a shape adds to the checksum at the given index, so that two
+// shapes trading places change the sum
+uint64_t placedHash(uint64_t hash, int index) {
+    return mix(hash + (uint64_t) (index + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+string encodeShape(const Shape *sp) {
+    string encoding;
+    ByteWriter out(encoding);
+    sp->encode(out);
+    return encoding;
+}
+
+}
+
+// Implementation notes: SceneEncoder class
+
+SceneEncoder::SceneEncoder(ShapeList & shapes) : shapes(shapes) {
+    nextId = 1;
+    checksum = 0;
+    shapes.setListener(this);
+    for (int i = 0; i < shapes.size(); i++) {
+        track(shapes[i], i);
+        const Tracked & entry = tracked.at(shapes[i]);
+        ByteWriter writer(pending);
+        writer.writeU8(OP_ADD);
+        writer.writeU32(entry.id);
+        writer.writeU32(i);
+        writer.writeString(entry.encoding);
+    }
+}
+
+SceneEncoder::~SceneEncoder() {
+    if (shapes.getListener() == this) shapes.setListener(nullptr);
+}
+
+void SceneEncoder::takeDelta(string & out) {
+    flushUpdates();
+    finish(out);
+}
+
+void SceneEncoder::takeSnapshot(string & out) {
+    pending.clear();
+    dirty.clear();
+    checksum = 0;
+    ByteWriter writer(pending);
+    writer.writeU8(OP_CLEAR);
+    for (int i = 0; i < shapes.size(); i++) {
+        Tracked & entry = tracked.at(shapes[i]);
+        entry.dirty = false;
+        entry.index = i;
+        entry.encoding = encodeShape(shapes[i]);
+        entry.hash = shapeHash(entry.id, entry.encoding);
+        checksum += placedHash(entry.hash, i);
+        writer.writeU8(OP_ADD);
+        writer.writeU32(entry.id);
+        writer.writeU32(i);
+        writer.writeString(entry.encoding);
+    }
+    finish(out);
+}
+
+bool SceneEncoder::hasChanges() const {
+    return !pending.empty() || !dirty.empty();
+}
+
+uint64_t SceneEncoder::getChecksum() const {
+    return checksum;
+}
+
+void SceneEncoder::shapeInserted(int index, Shape *sp) {
+    track(sp, index);
+    const Tracked & entry = tracked.at(sp);
+    ByteWriter writer(pending);
+    writer.writeU8(OP_ADD);
+    writer.writeU32(entry.id);
+    writer.writeU32(index);
+    writer.writeString(entry.encoding);
+    reindex(index + 1, shapes.size());
+}
+
+void SceneEncoder::shapeRemoved(int index, Shape *sp) {
+    auto it = tracked.find(sp);
+    if (it == tracked.end()) return;
+    checksum -= placedHash(it->second.hash, it->second.index);
+    ByteWriter writer(pending);
+    writer.writeU8(OP_REMOVE);
+    writer.writeU32(it->second.id);
+    tracked.erase(it);
+    reindex(index, shapes.size());
+}
+
+void SceneEncoder::shapeReordered(int from, int to) {
+    ByteWriter writer(pending);
+    writer.writeU8(OP_REORDER);
+    writer.writeU32(from);
+    writer.writeU32(to);
+    reindex(min(from, to), max(from, to) + 1);
+}
+
+void SceneEncoder::shapeUpdated(Shape *sp) {
+    auto it = tracked.find(sp);
+    if (it == tracked.end() || it->second.dirty) return;
+    it->second.dirty = true;
+    dirty.push_back(sp);
+}
+
+// Operations recorded before the clear no longer matter to a replica
+void SceneEncoder::shapesCleared() {
+    tracked.clear();
+    dirty.clear();
+    pending.clear();
+    checksum = 0;
+    ByteWriter writer(pending);
+    writer.writeU8(OP_CLEAR);
+}
+
+void SceneEncoder::track(Shape *sp, int index) {
+    if (tracked.count(sp) != 0) {
+        throw runtime_error("SceneEncoder: shape appears twice in the list");
+    }
+    Tracked entry;
+    entry.id = nextId++;
+    entry.dirty = false;
+    entry.index = index;
+    entry.encoding = encodeShape(sp);
+    entry.hash = shapeHash(entry.id, entry.encoding);
+    checksum += placedHash(entry.hash, index);
+    tracked.emplace(sp, std::move(entry));
+}
+
+/*
+ * Implementation notes: reindex
+ * -----------------------------
+ * Moves the checksum terms of the shapes in [begin, end) to the indices
+ * they now have. An insertion or removal shifts every shape after it by
+ * the same amount, so the scan stops at the first shape already in place;
+ * replacing a shape with set therefore shifts nothing and costs nothing.
+ */
+void SceneEncoder::reindex(int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        auto it = tracked.find(shapes[i]);
+        if (it == tracked.end()) continue;
+        Tracked & entry = it->second;
+        if (entry.index == i) break;
+        checksum -= placedHash(entry.hash, entry.index);
+        entry.index = i;
+        checksum += placedHash(entry.hash, i);
+    }
+}
+
+void SceneEncoder::flushUpdates() {
+    ByteWriter writer(pending);
+    for (Shape *sp : dirty) {
+        auto it = tracked.find(sp);
+        if (it == tracked.end() || !it->second.dirty) continue;
+        Tracked & entry = it->second;
+        entry.dirty = false;
+        string encoding = encodeShape(sp);
+        const string & old = entry.encoding;
+        size_t oldHeader = headerSize(old);
+        size_t newHeader = headerSize(encoding);
+        bool sameBody = old[0] == encoding[0] &&
+            old.compare(oldHeader, string::npos, encoding, newHeader) == 0;
+        if (!sameBody) {
+            writer.writeU8(OP_REPLACE);
+            writer.writeU32(entry.id);
+            writer.writeString(encoding);
+        } else {
+            if (old.compare(LOCATION_OFFSET, 16, encoding,
+                            LOCATION_OFFSET, 16) != 0) {
+                writer.writeU8(OP_MOVE);
+                writer.writeU32(entry.id);
+                pending.append(encoding, LOCATION_OFFSET, 16);
+            }
+            if (old.compare(COLOR_OFFSET, oldHeader - COLOR_OFFSET, encoding,
+                            COLOR_OFFSET, newHeader - COLOR_OFFSET) != 0) {
+                writer.writeU8(OP_COLOR);
+                writer.writeU32(entry.id);
+                pending.append(encoding, COLOR_OFFSET, newHeader - COLOR_OFFSET);
+            }
+        }
+        checksum -= placedHash(entry.hash, entry.index);
+        entry.hash = shapeHash(entry.id, encoding);
+        checksum += placedHash(entry.hash, entry.index);
+        entry.encoding = std::move(encoding);
+    }
+    dirty.clear();
+}
+
+void SceneEncoder::finish(string & out) {
+    ByteWriter writer(pending);
+    writer.writeU8(OP_END);
+    writer.writeU32((uint32_t) tracked.size());
+    writer.writeU64(checksum);
+    out += pending;
+    pending.clear();
+}
+
+// Implementation notes: SceneReplica class
+//
+// Every operation names its shape by id, so it is found through a hash
+// table.  Removing or replacing a shape also has to find its index, which
+// is a linear search, but no slower than the Vector operation it feeds.
+// After each change the replica hashes its own encoding of the shape,
+// which is how an applied change that did not reproduce the original
+// shape exactly shows up in the checksum.  Moves and recolors reach the
+// hash through shapeUpdated, like changes made by anyone else.
+
+SceneReplica::SceneReplica() {
+    checksum = 0;
+    shapes.setListener(this);
+}
+
+SceneReplica::~SceneReplica() {
+    clear();
+}
+
+bool SceneReplica::apply(const string & delta) {
+    return apply(delta.data(), delta.size());
+}
+
+bool SceneReplica::apply(const char *data, size_t size) {
+    ByteReader in(data, size);
+    bool consistent = true;
+    while (!in.atEnd()) {
+        int op = in.readU8();
+        switch (op) {
+        case OP_ADD: case OP_REPLACE: {
+            uint32_t id = in.readU32();
+            uint32_t index = (op == OP_ADD) ? in.readU32() : 0;
+            string encoding = in.readString();
+            ByteReader reader(encoding.data(), encoding.size());
+            Shape *sp = Shape::decode(reader);
+            bool known = entries.count(id) != 0;
+            bool valid = (op == OP_ADD)
+                ? !known && index <= (uint32_t) shapes.size() : known;
+            if (!reader.atEnd() || !valid) {
+                delete sp;
+                throw runtime_error("SceneReplica: invalid shape operation");
+            }
+            if (op == OP_ADD) {
+                shapes.insert(index, sp);
+                uint64_t hash = shapeHash(id, encodeShape(sp));
+                entries[id] = Entry { sp, (int) index, hash };
+                checksum += placedHash(hash, index);
+            } else {
+                Entry & entry = entries.at(id);
+                Shape *old = entry.shape;
+                shapes.set(entry.index, sp);
+                ids.erase(old);
+                delete old;
+                entry.shape = sp;
+                rehash(id);
+            }
+            ids[sp] = id;
+            break;
+        }
+        case OP_REMOVE: {
+            uint32_t id = in.readU32();
+            Shape *sp = find(id);
+            Entry & entry = entries.at(id);
+            shapes.remove(entry.index);
+            checksum -= placedHash(entry.hash, entry.index);
+            entries.erase(id);
+            ids.erase(sp);
+            delete sp;
+            break;
+        }
+        case OP_MOVE: {
+            uint32_t id = in.readU32();
+            double x = in.readDouble();
+            double y = in.readDouble();
+            find(id)->setLocation(x, y);
+            break;
+        }
+        case OP_COLOR: {
+            uint32_t id = in.readU32();
+            find(id)->setColor(in.readString());
+            break;
+        }
+        case OP_REORDER: {
+            int from = in.readU32();
+            int to = in.readU32();
+            int n = shapes.size();
+            if (from < 0 || from >= n || to < 0 || to >= n) {
+                throw runtime_error("SceneReplica: reorder index out of range");
+            }
+            shapes.moveTo(shapes[from], to);
+            break;
+        }
+        case OP_CLEAR:
+            clear();
+            break;
+        case OP_END: {
+            uint32_t count = in.readU32();
+            uint64_t expected = in.readU64();
+            if (count != entries.size() || expected != checksum) {
+                consistent = false;
+            }
+            break;
+        }
+        default:
+            throw runtime_error("SceneReplica: unknown delta operation");
+        }
+    }
+    return consistent;
+}
+
+const ShapeList & SceneReplica::getShapes() const {
+    return shapes;
+}
+
+uint64_t SceneReplica::getChecksum() const {
+    return checksum;
+}
+
+Shape *SceneReplica::find(uint32_t id) const {
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        throw runtime_error("SceneReplica: unknown shape id");
+    }
+    return it->second.shape;
+}
+
+// The shape itself is placed in the checksum by apply
+void SceneReplica::shapeInserted(int index, Shape *) {
+    reindex(index + 1, shapes.size());
+}
+
+void SceneReplica::shapeRemoved(int index, Shape *) {
+    reindex(index, shapes.size());
+}
+
+void SceneReplica::shapeReordered(int from, int to) {
+    reindex(min(from, to), max(from, to) + 1);
+}
+
+void SceneReplica::shapeUpdated(Shape *sp) {
+    auto it = ids.find(sp);
+    if (it != ids.end()) rehash(it->second);
+}
+
+void SceneReplica::shapesCleared() {
+}
+
+void SceneReplica::rehash(uint32_t id) {
+    Entry & entry = entries.at(id);
+    checksum -= placedHash(entry.hash, entry.index);
+    entry.hash = shapeHash(id, encodeShape(entry.shape));
+    checksum += placedHash(entry.hash, entry.index);
+}
+
+// Works as SceneEncoder::reindex does
+void SceneReplica::reindex(int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        auto it = ids.find(shapes[i]);
+        if (it == ids.end()) continue;
+        Entry & entry = entries.at(it->second);
+        if (entry.index == i) break;
+        checksum -= placedHash(entry.hash, entry.index);
+        entry.index = i;
+        checksum += placedHash(entry.hash, i);
+    }
+}
+
+void SceneReplica::clear() {
+    shapes.clear();
+    for (auto & item : entries) {
+        delete item.second.shape;
+    }
+    entries.clear();
+    ids.clear();
+    checksum = 0;
+}
@@ -0,0 +1,142 @@
+/*
+* File: scenedelta.h
+* ------------------
+* This file defines a SceneEncoder class that records the changes made to
+* a ShapeList as a compact binary delta stream, and a SceneReplica class
+* that applies such a stream to a copy of the scene, possibly in another
+* process.
+*/
+#ifndef _scenedelta_h
+#define _scenedelta_h
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "shapelist.h"
+/*
+* Class: SceneEncoder
+* -------------------
+* Listens to a ShapeList and turns its changes into deltas. Insertions,
+* removals and reorders are recorded as they happen. Changes to the
+* shapes themselves are coalesced: a shape that changes many times
+* between two calls to takeDelta is sent once, as a new location, a new
+* color or, if its geometry changed, a complete replacement. Each delta
+* ends with the number of shapes and a checksum of the scene, which the
+* replica compares against its own to detect drift. The encoder gives
+* each shape an id, so a shape may appear in the list only once.
+*/
+class SceneEncoder : public ShapeListListener {
+public:
+/*
+* Constructor: SceneEncoder
+* Usage: SceneEncoder encoder(shapes);
+* ------------------------------------
+* Becomes the listener of shapes. The first delta adds the shapes the list
+* already holds, so a new replica can start from it.
+*/
+explicit SceneEncoder(ShapeList & shapes);
+~SceneEncoder();
+SceneEncoder(const SceneEncoder &) = delete;
+SceneEncoder & operator=(const SceneEncoder &) = delete;
+/*
+* Method: takeDelta
+* Usage: encoder.takeDelta(out);
+* ------------------------------
+* Appends the changes made since the last call to out, and starts a new
+* delta. The cost is proportional to the number and size of the changed
+* shapes, not to the size of the scene.
+*/
+void takeDelta(std::string & out);
+/*
+* Method: takeSnapshot
+* Usage: encoder.takeSnapshot(out);
+* ---------------------------------
+* Appends a delta that clears a replica and adds every shape, for
+* resynchronizing a replica that has drifted. Pending changes are folded
+* into the snapshot.
+*/
+void takeSnapshot(std::string & out);
+bool hasChanges() const;
+/*
+* Method: getChecksum
+* Usage: uint64_t sum = encoder.getChecksum();
+* --------------------------------------------
+* Returns the checksum of the scene as of the last delta. The checksum
+* sums a hash of every shape's id, encoding and index in the list, so it
+* can be kept up to date as shapes change, and a replica whose stacking
+* order has drifted fails to match it. Inserting, removing or reordering
+* shapes rehashes the shapes whose index it shifts.
+*/
+uint64_t getChecksum() const;
+virtual void shapeInserted(int index, Shape *sp);
+virtual void shapeRemoved(int index, Shape *sp);
+virtual void shapeReordered(int from, int to);
+virtual void shapeUpdated(Shape *sp);
+virtual void shapesCleared();
+private:
+struct Tracked {
+uint32_t id;
+bool dirty;
+int index;                    // The index hash was placed at
+uint64_t hash;
+std::string encoding;
+};
+void track(Shape *sp, int index);
+void reindex(int begin, int end);
+void flushUpdates();
+void finish(std::string & out);
+ShapeList & shapes;
+std::unordered_map<Shape *, Tracked> tracked;
+std::vector<Shape *> dirty;
+std::string pending;
+uint32_t nextId;
+uint64_t checksum;
+};
+/*
+* Class: SceneReplica
+* -------------------
+* A copy of a scene built from the deltas of a SceneEncoder. The replica
+* owns the shapes it creates and deletes them when they are removed. It
+* listens to its own list, so a shape changed behind its back also shows
+* up as a checksum mismatch.
+*/
+class SceneReplica : private ShapeListListener {
+public:
+SceneReplica();
+~SceneReplica();
+SceneReplica(const SceneReplica &) = delete;
+SceneReplica & operator=(const SceneReplica &) = delete;
+/*
+* Method: apply
+* Usage: if (!replica.apply(delta.data(), delta.size())) ...
+* ----------------------------------------------------------
+* Applies one or more deltas in the time it takes to apply the changes
+* they contain. Returns false if the replica's shape count or checksum
+* differs from the encoder's afterwards, in which case the caller should
+* request a snapshot. Throws a runtime_error if the data is malformed.
+*/
+bool apply(const char *data, size_t size);
+bool apply(const std::string & delta);
+const ShapeList & getShapes() const;
+uint64_t getChecksum() const;
+private:
+struct Entry {
+Shape *shape;
+int index;
+uint64_t hash;
+};
+virtual void shapeInserted(int index, Shape *sp);
+virtual void shapeRemoved(int index, Shape *sp);
+virtual void shapeReordered(int from, int to);
+virtual void shapeUpdated(Shape *sp);
+virtual void shapesCleared();
+Shape *find(uint32_t id) const;
+void rehash(uint32_t id);
+void reindex(int begin, int end);
+void clear();
+ShapeList shapes;
+std::unordered_map<uint32_t, Entry> entries;
+std::unordered_map<Shape *, uint32_t> ids;
+uint64_t checksum;
+};
+#endif
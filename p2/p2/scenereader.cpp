@@ -0,0 +1,388 @@
+/*
+ * File: scenereader.cpp
+ * ---------------------
+ * This file implements the SceneReader class.
+ */
+
+#include "scenereader.h"
+#include "parallel.h"
+#include "strlib.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SCENEREADER_MMAP
+#endif
+
+using namespace std;
+
+namespace {
+
+const size_t BLOCK_SIZE = 4 << 20;      // Bytes read from a stream at once
+const size_t MIN_PIECE = 256 << 10;     // Fewest bytes worth a thread
+
+/*
+ * Type: Record
+ * ------------
+ * The fields of one line. A null type marks a blank or comment line, and
+ * color is empty if the line names none.
+ */
+struct Record {
+    ShapeType type;
+    double values[4];
+    string_view color;
+};
+
+/*
+ * Type: Piece
+ * -----------
+ * A run of whole lines parsed by one thread, with the shapes made from it
+ * and, if a line is bad, the number of that line within the piece, what is
+ * wrong with it, and the offending text.
+ */
+struct Piece {
+    const char *begin;
+    const char *end;
+    vector<Shape *> shapes;
+    long lines;
+    long errorLine;
+    const char *error;
+    string_view errorText;
+};
+
+bool isBlank(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+// Removes the next field from the front of rest and returns it
+string_view nextField(string_view & rest) {
+    size_t start = 0;
+    while (start < rest.size() && isBlank(rest[start])) start++;
+    size_t end = start;
+    while (end < rest.size() && !isBlank(rest[end])) end++;
+    string_view field = rest.substr(start, end - start);
+    rest.remove_prefix(end);
+    return field;
+}
+
+/*
+ * Implementation notes: parseNumber
+ * ---------------------------------
+ * std::from_chars converts in place without consulting the locale. Where
+ * the library lacks the floating-point overloads, which __cpp_lib_to_chars
+ * reports, the field is copied to a buffer on the stack for strtod, which
+ * needs a terminated string.
+ */
+bool parseNumber(string_view field, double & value) {
+    if (field.empty()) return false;
+#if defined(__cpp_lib_to_chars)
+    const char *end = field.data() + field.size();
+    from_chars_result result = from_chars(field.data(), end, value);
+    if (result.ec != errc() || result.ptr != end) return false;
+#else
+    char buffer[64];
+    if (field.size() >= sizeof buffer || field[0] == '+') return false;
+    memcpy(buffer, field.data(), field.size());
+    buffer[field.size()] = '\0';
+    char *end;
+    value = strtod(buffer, &end);
+    if (end != buffer + field.size()) return false;
+#endif
+    return isfinite(value);
+}
+
+/*
+ * Function: parseRecord
+ * ---------------------
+ * Splits line into record and returns nullptr, or describes what is wrong
+ * with the line and sets bad to the text at fault.
+ */
+const char *parseRecord(string_view line, Record & record, string_view & bad) {
+    string_view rest = line;
+    string_view keyword = nextField(rest);
+    record.type = ShapeType();
+    if (keyword.empty() || keyword[0] == '#') return nullptr;
+    int count = 4;
+    if (equalsIgnoreCase(keyword, "LINE")) {
+        record.type = SHAPE_LINE;
+    } else if (equalsIgnoreCase(keyword, "RECT")) {
+        record.type = SHAPE_RECT;
+    } else if (equalsIgnoreCase(keyword, "SQUARE")) {
+        record.type = SHAPE_SQUARE;
+        count = 3;
+    } else if (equalsIgnoreCase(keyword, "OVAL")) {
+        record.type = SHAPE_OVAL;
+    } else {
+        bad = keyword;
+        return "unknown shape";
+    }
+    for (int i = 0; i < count; i++) {
+        string_view field = nextField(rest);
+        if (field.empty()) {
+            bad = trimView(line);
+            return "too few numbers in";
+        }
+        if (!parseNumber(field, record.values[i])) {
+            bad = field;
+            return "bad number";
+        }
+    }
+    record.color = trimView(rest);
+    if (!record.color.empty() && !resolveColor(record.color).isValid()) {
+        bad = record.color;
+        return "unknown color";
+    }
+    return nullptr;
+}
+
+Shape *createShape(const Record & record) {
+    const double *v = record.values;
+    Shape *sp;
+    switch (record.type) {
+    case SHAPE_LINE:
+        sp = new Line(v[0], v[1], v[2], v[3]);
+        break;
+    case SHAPE_SQUARE:
+        sp = new Square(v[0], v[1], v[2]);
+        break;
+    case SHAPE_RECT:
+        sp = new Rect(v[0], v[1], v[2], v[3]);
+        break;
+    default:
+        sp = new Oval(v[0], v[1], v[2], v[3]);
+        break;
+    }
+    if (!record.color.empty()) {
+        try {
+            sp->setColor(string(record.color));
+        } catch (...) {
+            delete sp;
+            throw;
+        }
+    }
+    return sp;
+}
+
+// Parses the lines of piece until the end or the first bad line
+void parsePiece(Piece & piece) {
+    const char *p = piece.begin;
+    Record record;
+    string_view bad;
+    while (p < piece.end) {
+        const char *eol = (const char *) memchr(p, '\n', piece.end - p);
+        if (eol == nullptr) eol = piece.end;
+        piece.lines++;
+        const char *error = parseRecord(string_view(p, eol - p), record, bad);
+        if (error != nullptr) {
+            piece.errorLine = piece.lines;
+            piece.error = error;
+            piece.errorText = bad;
+            return;
+        }
+        if (record.type != ShapeType()) {
+            piece.shapes.push_back(nullptr);
+            piece.shapes.back() = createShape(record);
+        }
+        p = eol + 1;
+    }
+}
+
+void deleteShapes(vector<Shape *> & shapes) {
+    for (Shape *sp : shapes) {
+        delete sp;
+    }
+    shapes.clear();
+}
+
+/*
+ * Implementation notes: parseBlock
+ * --------------------------------
+ * The text is cut into one piece per thread, each moved forward to just
+ * after a line break, so the pieces hold whole lines and the threads share
+ * nothing but the text. Lines are numbered within each piece while it is
+ * parsed; the number of a bad line in the whole text is found afterward
+ * from the counts of the pieces before it, all of which were parsed to the
+ * end. The shapes of the pieces are appended to created in order, and
+ * lines is advanced past the lines of text.
+ */
+void parseBlock(string_view text, long & lines, int threadCount,
+                vector<Shape *> & created) {
+    if (threadCount <= 0) threadCount = getDefaultThreadCount();
+    int parts = (int) max<size_t>(1, min<size_t>(threadCount,
+                                                 text.size() / MIN_PIECE));
+    vector<Piece> pieces(parts);
+    const char *start = text.data();
+    const char *end = text.data() + text.size();
+    for (int k = 0; k < parts; k++) {
+        const char *cut = end;
+        if (k < parts - 1) {
+            cut = max(start, text.data() + text.size() * (k + 1) / parts);
+            const char *eol = (const char *) memchr(cut, '\n', end - cut);
+            cut = (eol == nullptr) ? end : eol + 1;
+        }
+        pieces[k] = { start, cut, {}, 0, 0, nullptr, {} };
+        start = cut;
+    }
+    try {
+        parallelFor(parts, parts, [&](int begin, int finish) {
+            for (int k = begin; k < finish; k++) {
+                parsePiece(pieces[k]);
+            }
+        }, 1);
+        size_t total = 0;
+        for (const Piece & piece : pieces) {
+            if (piece.error != nullptr) {
+                throw runtime_error("SceneReader: line "
+                                    + to_string(lines + piece.errorLine) + ": "
+                                    + piece.error + " \""
+                                    + string(piece.errorText) + "\"");
+            }
+            lines += piece.lines;
+            total += piece.shapes.size();
+        }
+        created.reserve(created.size() + total);
+    } catch (...) {
+        for (Piece & piece : pieces) {
+            deleteShapes(piece.shapes);
+        }
+        throw;
+    }
+    for (Piece & piece : pieces) {
+        created.insert(created.end(), piece.shapes.begin(), piece.shapes.end());
+    }
+}
+
+#ifdef SCENEREADER_MMAP
+
+/*
+ * Class: MappedFile
+ * -----------------
+ * Maps a regular file into memory read-only for as long as the object
+ * lives. The mapping is absent if the file cannot be opened, is empty, or
+ * is not a regular file.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const string & filename) {
+        data = nullptr;
+        length = 0;
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void *p = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data = (const char *) p;
+                length = info.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (data != nullptr) munmap((void *) data, length);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    bool isMapped() const {
+        return data != nullptr;
+    }
+
+    string_view getText() const {
+        return string_view(data, length);
+    }
+
+private:
+    const char *data;
+    size_t length;
+};
+
+#endif
+
+}
+
+SceneReader::SceneReader() {
+    threadCount = 0;
+}
+
+void SceneReader::setThreadCount(int count) {
+    threadCount = max(0, count);
+}
+
+int SceneReader::getThreadCount() const {
+    return threadCount;
+}
+
+int SceneReader::readFile(const string & filename, ShapeList & shapes) {
+#ifdef SCENEREADER_MMAP
+    MappedFile file(filename);
+    if (file.isMapped()) return parse(file.getText(), shapes);
+#endif
+    ifstream in(filename, ios::binary);
+    if (!in) throw runtime_error("SceneReader: can't open " + filename);
+    return read(in, shapes);
+}
+
+/*
+ * Implementation notes: read
+ * --------------------------
+ * Each block is parsed up to its last line break, and the partial line
+ * after it is moved to the front of the buffer to be completed by the next
+ * read. The buffer grows only if a single line fills it.
+ */
+int SceneReader::read(istream & in, ShapeList & shapes) {
+    vector<char> buffer(BLOCK_SIZE);
+    vector<Shape *> created;
+    size_t carried = 0;
+    long lines = 0;
+    try {
+        while (true) {
+            if (carried == buffer.size()) buffer.resize(2 * buffer.size());
+            in.read(buffer.data() + carried, buffer.size() - carried);
+            if (in.bad()) throw runtime_error("SceneReader: read error");
+            size_t filled = carried + (size_t) in.gcount();
+            bool done = !in;
+            size_t cut = filled;
+            if (!done) {
+                while (cut > 0 && buffer[cut - 1] != '\n') cut--;
+            }
+            if (cut > 0) {
+                parseBlock(string_view(buffer.data(), cut), lines, threadCount,
+                           created);
+            }
+            carried = filled - cut;
+            memmove(buffer.data(), buffer.data() + cut, carried);
+            if (done) break;
+        }
+    } catch (...) {
+        deleteShapes(created);
+        throw;
+    }
+    shapes.addAll(created.data(), (int) created.size());
+    return (int) created.size();
+}
+
+int SceneReader::parse(string_view text, ShapeList & shapes) {
+    vector<Shape *> created;
+    long lines = 0;
+    try {
+        parseBlock(text, lines, threadCount, created);
+    } catch (...) {
+        deleteShapes(created);
+        throw;
+    }
+    shapes.addAll(created.data(), (int) created.size());
+    return (int) created.size();
+}
@@ -0,0 +1,83 @@
+/*
+* File: scenereader.h
+* -------------------
+* This file defines a SceneReader class that loads shapes from the text
+* scene format, one shape per line.
+*/
+#ifndef _scenereader_h
+#define _scenereader_h
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+#include "shapelist.h"
+/*
+* Class: SceneReader
+* ------------------
+* Reads scenes written as lines of the forms
+*
+* LINE x1 y1 x2 y2 color
+* RECT x y width height color
+* SQUARE x y size color
+* OVAL x y width height color
+*
+* The keywords may be in any case and the color, which is optional and
+* defaults to black, is anything resolveColor accepts, spaces included.
+* Blank lines and lines starting with # are ignored. Fields are separated
+* by spaces or tabs, and lines may end with CR LF.
+*
+* The reader tokenizes the text in place without copying it, converts
+* numbers with std::from_chars, and splits large inputs at line breaks
+* into pieces that are parsed on separate threads. A scene is added to the
+* list in file order as one update group, and only if every line of it is
+* valid; otherwise the reader signals an error naming the first bad line
+* and the list is left unchanged.
+*/
+class SceneReader {
+public:
+/*
+* Constructor: SceneReader
+* Usage: SceneReader reader;
+* --------------------------
+* Creates a reader that uses as many threads as the hardware runs at
+* once.
+*/
+SceneReader();
+/*
+* Methods: setThreadCount, getThreadCount
+* Usage: reader.setThreadCount(n);
+* --------------------------------
+* Set the number of threads that parse each piece of input, or 0 for as
+* many as the hardware runs at once.
+*/
+void setThreadCount(int count);
+int getThreadCount() const;
+/*
+* Method: readFile
+* Usage: int count = reader.readFile(filename, shapes);
+* -----------------------------------------------------
+* Adds the shapes in the named file to shapes and returns their number.
+* Where the system supports it, the file is mapped into memory and parsed
+* where it lies; otherwise it is read in blocks as read does.
+*/
+int readFile(const std::string & filename, ShapeList & shapes);
+/*
+* Method: read
+* Usage: int count = reader.read(in, shapes);
+* -------------------------------------------
+* Adds the shapes in the rest of the stream to shapes and returns their
+* number. The stream is read in blocks of a few megabytes, so the text is
+* never held in memory all at once.
+*/
+int read(std::istream & in, ShapeList & shapes);
+/*
+* Method: parse
+* Usage: int count = reader.parse(text, shapes);
+* ----------------------------------------------
+* Adds the shapes described by text to shapes and returns their number.
+*/
+int parse(std::string_view text, ShapeList & shapes);
+private:
+int threadCount;
+};
+#endif
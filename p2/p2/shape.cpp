@@ -1,28 +1,114 @@
 #include <string>
 #include "gwindow.h"
 #include "shape.h"
+#include "instrument.h"
+#include "bytestream.h"
 #include <cmath>
+#include <algorithm>
+#include <stdexcept>
 
 using namespace std;
 
 // Implementation notes: Shape class
 
 Shape::Shape() {
+    observer = NULL;
     setColor("BLACK");
 }
 
 void Shape::setLocation(double x, double y) {
     this->x = x;
     this->y = y;
+    changed();
 }
 
 void Shape::move(double dx, double dy) {
     x += dx;
     y += dy;
+    changed();
 }
 
 void Shape::setColor(const string & color) {
     this->color = color;
+    colorId = resolveColor(color);
+    changed();
+}
+
+void Shape::setColor(ColorId color) {
+    if (!color.isValid()) throw runtime_error("Shape::setColor: Undefined color");
+    static const char HEX[] = "0123456789abcdef";
+    char name[7] = { '#' };
+    int rgb = color.getRGB();
+    for (int k = 0; k < 6; k++) {
+        name[6 - k] = HEX[(rgb >> (4 * k)) & 0xF];
+    }
+    setColor(string(name, 7));
+}
+
+GPoint Shape::getLocation() const {
+    return GPoint(x, y);
+}
+
+void Shape::draw(GWindow & gw) {
+    WindowTarget target(gw);
+    draw(target);
+}
+
+bool Shape::isFilled() const {
+    return true;
+}
+
+const string & Shape::getColor() const {
+    return color;
+}
+
+// Short strings are stored inside the string object itself
+size_t Shape::getColorHeapBytes() const {
+    return (color.capacity() > std::string().capacity()) ? color.capacity() + 1
+                                                         : 0;
+}
+
+ColorId Shape::getColorId() const {
+    return colorId;
+}
+
+void Shape::setObserver(ShapeObserver *observer) {
+    this->observer = observer;
+}
+
+ShapeObserver *Shape::getObserver() const {
+    return observer;
+}
+
+void Shape::changed() {
+    if (observer != NULL) observer->shapeChanged(this);
+}
+
+void Shape::encodeHeader(ByteWriter & out, ShapeType type) const {
+    out.writeU8((uint8_t) type);
+    out.writeDouble(x);
+    out.writeDouble(y);
+    out.writeString(color);
+}
+
+void Shape::decodeHeader(ByteReader & in) {
+    x = in.readDouble();
+    y = in.readDouble();
+    color = in.readString();
+    colorId = resolveColor(color);
+}
+
+Shape *Shape::decode(ByteReader & in) {
+    switch (in.readU8()) {
+    case SHAPE_LINE: return new Line(in);
+    case SHAPE_SQUARE: return new Square(in);
+    case SHAPE_RECT: return new Rect(in);
+    case SHAPE_OVAL: return new Oval(in);
+    case SHAPE_POLYLINE: return new Polyline(in);
+    case SHAPE_POLYGON: return new Polygon(in);
+    case SHAPE_GROUP: return new ShapeGroup(in);
+    }
+    throw runtime_error("Shape::decode: unknown shape type");
 }
 
 Line::Line(double x1, double y1, double x2, double y2) {
@@ -30,36 +116,65 @@ Line::Line(double x1, double y1, double x2, double y2) {
     this->y = y1;
     this->dx = x2 - x1;
     this->dy = y2 - y1;
+    double norm = dx * dx + dy * dy;
+    invNorm = (norm == 0) ? 0 : 1 / norm;
 }
 
-void Line::draw(GWindow & gw) {
-    gw.setColor(color);
-    gw.drawLine(x, y, x + dx, y + dy);
+Line::Line(ByteReader & in) {
+    decodeHeader(in);
+    dx = in.readDouble();
+    dy = in.readDouble();
+    double norm = dx * dx + dy * dy;
+    invNorm = (norm == 0) ? 0 : 1 / norm;
 }
 
-bool Line::contains(double x, double y) const{
-    double x2 = this->x + dx;
-    double y2 = this->y + dy;
+void Line::draw(RenderTarget & target) {
+    target.setColor(colorId);
+    target.drawLine(x, y, x + dx, y + dy);
+}
+
+Shape *Line::clone() const {
+    Line *copy = new Line(*this);
+    copy->observer = NULL;
+    return copy;
+}
 
-    double px = x2 - this->x;
-    double py = y2 - this->y;
+void Line::encode(ByteWriter & out) const {
+    encodeHeader(out, SHAPE_LINE);
+    out.writeDouble(dx);
+    out.writeDouble(dy);
+}
+
+// The cached inverse length depends only on (dx, dy), which moving the
+// line leaves alone; a zero-length line projects every point onto its
+// start, so it contains the points within half a pixel of that point.
+bool Line::contains(double x, double y) const{
+    double qx = x - this->x;
+    double qy = y - this->y;
 
-    double norm = px*px + py*py;
-    double u = ((x - this->x) * px + (y - this->y) * py) / norm;
+    double u = (qx * dx + qy * dy) * invNorm;
 
     if (u > 1) u = 1;
     if (u < 0) u = 0;
 
-    double x_proj = this->x + u * px;
-    double y_proj = this->y + u * py;
+    double ex = u * dx - qx;
+    double ey = u * dy - qy;
 
-    double dx = x_proj - x;
-    double dy = y_proj - y;
+    return ex * ex + ey * ey <= 0.25;
+}
 
-    double dist = sqrt(dx*dx + dy*dy);
+// The bounds include the half-pixel tolerance used by contains
+GRectangle Line::getBounds() const {
+    return GRectangle(min(x, x + dx) - 0.5, min(y, y + dy) - 0.5,
+                      fabs(dx) + 1, fabs(dy) + 1);
+}
 
-    return dist <= 0.5;
-    
+size_t Line::getMemoryUsage() const {
+    return sizeof(Line) + getColorHeapBytes();
+}
+
+bool Line::isFilled() const {
+    return false;
 }
 
 Square::Square(double x, double y, double size) {
@@ -68,9 +183,30 @@ Square::Square(double x, double y, double size) {
     this->size = size;
 }
 
-void Square::draw(GWindow & gw) {
-    gw.setColor(color);
-    gw.fillRect(x, y, size, size);
+Square::Square(ByteReader & in) {
+    decodeHeader(in);
+    size = in.readDouble();
+}
+
+void Square::setSize(double size) {
+    this->size = size;
+    changed();
+}
+
+void Square::draw(RenderTarget & target) {
+    target.setColor(colorId);
+    target.fillRect(x, y, size, size);
+}
+
+Shape *Square::clone() const {
+    Square *copy = new Square(*this);
+    copy->observer = NULL;
+    return copy;
+}
+
+void Square::encode(ByteWriter & out) const {
+    encodeHeader(out, SHAPE_SQUARE);
+    out.writeDouble(size);
 }
 
 bool Square::contains(double x, double y) const {
@@ -78,6 +214,14 @@ bool Square::contains(double x, double y) const {
            y >= this->y && y <= this->y + size;
 }
 
+GRectangle Square::getBounds() const {
+    return GRectangle(x, y, size, size);
+}
+
+size_t Square::getMemoryUsage() const {
+    return sizeof(Square) + getColorHeapBytes();
+}
+
 Rect::Rect(double x, double y, double width, double height) {
     this->x = x;
     this->y = y;
@@ -85,9 +229,33 @@ Rect::Rect(double x, double y, double width, double height) {
     this->height = height;
 }
 
-void Rect::draw(GWindow& gw) {
-    gw.setColor(color);
-    gw.fillRect(x, y, width, height);
+Rect::Rect(ByteReader & in) {
+    decodeHeader(in);
+    width = in.readDouble();
+    height = in.readDouble();
+}
+
+void Rect::setSize(double width, double height) {
+    this->width = width;
+    this->height = height;
+    changed();
+}
+
+void Rect::draw(RenderTarget & target) {
+    target.setColor(colorId);
+    target.fillRect(x, y, width, height);
+}
+
+Shape *Rect::clone() const {
+    Rect *copy = new Rect(*this);
+    copy->observer = NULL;
+    return copy;
+}
+
+void Rect::encode(ByteWriter & out) const {
+    encodeHeader(out, SHAPE_RECT);
+    out.writeDouble(width);
+    out.writeDouble(height);
 }
 
 bool Rect::contains(double x, double y) const{
@@ -95,25 +263,542 @@ bool Rect::contains(double x, double y) const{
            y >= this->y && y <= this->y + height;
 }
 
+GRectangle Rect::getBounds() const {
+    return GRectangle(x, y, width, height);
+}
+
+size_t Rect::getMemoryUsage() const {
+    return sizeof(Rect) + getColorHeapBytes();
+}
+
 Oval::Oval(double x, double y, double width, double height) {
     this->x = x;
     this->y = y;
     this->width = width;
     this->height = height;
+    updateAxes();
+}
+
+Oval::Oval(ByteReader & in) {
+    decodeHeader(in);
+    width = in.readDouble();
+    height = in.readDouble();
+    updateAxes();
+}
+
+void Oval::updateAxes() {
+    cx = x + width / 2;
+    cy = y + height / 2;
+    bool empty = width <= 0 || height <= 0;
+    invA2 = empty ? 0 : 4 / (width * width);
+    invB2 = empty ? 0 : 4 / (height * height);
 }
 
-void Oval::draw(GWindow& gw) {
-    gw.setColor(color);
-    gw.fillOval(x, y, width, height);
+void Oval::setSize(double width, double height) {
+    this->width = width;
+    this->height = height;
+    updateAxes();
+    changed();
 }
 
+void Oval::setLocation(double x, double y) {
+    cx = x + width / 2;
+    cy = y + height / 2;
+    Shape::setLocation(x, y);
+}
+
+void Oval::move(double dx, double dy) {
+    cx += dx;
+    cy += dy;
+    Shape::move(dx, dy);
+}
+
+void Oval::draw(RenderTarget & target) {
+    target.setColor(colorId);
+    target.fillOval(x, y, width, height);
+}
+
+Shape *Oval::clone() const {
+    Oval *copy = new Oval(*this);
+    copy->observer = NULL;
+    return copy;
+}
+
+void Oval::encode(ByteWriter & out) const {
+    encodeHeader(out, SHAPE_OVAL);
+    out.writeDouble(width);
+    out.writeDouble(height);
+}
+
+// An oval without area has zero inverses and contains no points
 bool Oval::contains(double x, double y) const{
-    double h = this->x + width/2;
-    double k = this->y + height/2;
-    double a = width/2;
-    double b = height/2;
+    double ex = x - cx;
+    double ey = y - cy;
+    return invA2 > 0 && ex * ex * invA2 + ey * ey * invB2 <= 1;
+}
+
+GRectangle Oval::getBounds() const {
+    return GRectangle(x, y, width, height);
+}
+
+size_t Oval::getMemoryUsage() const {
+    return sizeof(Oval) + getColorHeapBytes();
+}
+
+// Implementation notes: Polyline and Polygon classes
+//
+// The bounds are kept relative to the location as well, so a query is
+// translated once into vertex space and every test after that reads the
+// vertex array directly.  Outlines shorter than BUCKET_THRESHOLD vertices
+// are scanned edge by edge, since an index would not pay for itself.
+
+namespace {
+
+const int BUCKET_THRESHOLD = 32;
+
+// Returns the squared distance from (px, py) to the segment (x0, y0)-(x1, y1)
+double segmentDistance2(double px, double py,
+                        double x0, double y0, double x1, double y1) {
+    double ex = x1 - x0;
+    double ey = y1 - y0;
+    double norm = ex * ex + ey * ey;
+    double u = (norm == 0) ? 0 : ((px - x0) * ex + (py - y0) * ey) / norm;
+    if (u > 1) u = 1;
+    if (u < 0) u = 0;
+    double dx = x0 + u * ex - px;
+    double dy = y0 + u * ey - py;
+    return dx * dx + dy * dy;
+}
+
+}
+
+Polyline::Polyline() {
+    x = y = 0;
+    left = top = right = bottom = 0;
+    closed = false;
+}
+
+Polyline::Polyline(bool closed) : Polyline() {
+    this->closed = closed;
+}
+
+Polyline::Polyline(const double *coords, int count) : Polyline() {
+    for (int k = 0; k < count; k++) {
+        addVertex(coords[2 * k], coords[2 * k + 1]);
+    }
+}
+
+Polyline::Polyline(ByteReader & in) : Polyline() {
+    decodeHeader(in);
+    decodeVertices(in);
+}
+
+void Polyline::addVertex(double vx, double vy) {
+    if (coords.empty()) {
+        x = vx;
+        y = vy;
+    }
+    double rx = vx - x;
+    double ry = vy - y;
+    if (coords.empty()) {
+        left = right = rx;
+        top = bottom = ry;
+    } else {
+        left = min(left, rx);
+        right = max(right, rx);
+        top = min(top, ry);
+        bottom = max(bottom, ry);
+    }
+    coords.push_back(rx);
+    coords.push_back(ry);
+    buckets.clear();
+    changed();
+}
+
+int Polyline::getVertexCount() const {
+    return (int) coords.size() / 2;
+}
+
+void Polyline::draw(RenderTarget & target) {
+    target.setColor(colorId);
+    target.drawPolyline(coords.data(), getVertexCount(), x, y, closed);
+}
+
+Shape *Polyline::clone() const {
+    Polyline *copy = new Polyline(*this);
+    copy->observer = NULL;
+    return copy;
+}
+
+void Polyline::encode(ByteWriter & out) const {
+    encodeHeader(out, SHAPE_POLYLINE);
+    encodeVertices(out);
+}
+
+bool Polyline::contains(double x, double y) const {
+    int n = getVertexCount();
+    if (n == 0) return false;
+    double qx = x - this->x;
+    double qy = y - this->y;
+    if (qx < left - 0.5 || qx > right + 0.5 ||
+        qy < top - 0.5 || qy > bottom + 0.5) return false;
+    const double *v = coords.data();
+    auto hits = [v, n, qx, qy](int k) {
+        int m = (k + 1) % n;
+        return segmentDistance2(qx, qy, v[2 * k], v[2 * k + 1],
+                                v[2 * m], v[2 * m + 1]) <= 0.25;
+    };
+    const EdgeBuckets *index = getBuckets(0.5);
+    if (index != NULL) {
+        const int *first, *last;
+        if (!index->find(qy, first, last)) return false;
+        for (const int *p = first; p != last; p++) {
+            if (hits(*p)) return true;
+        }
+        return false;
+    }
+    int edges = closed ? n : max(1, n - 1);
+    for (int k = 0; k < edges; k++) {
+        if (hits(k)) return true;
+    }
+    return false;
+}
+
+// The bounds include the half-pixel tolerance used by contains
+GRectangle Polyline::getBounds() const {
+    return GRectangle(x + left - 0.5, y + top - 0.5,
+                      right - left + 1, bottom - top + 1);
+}
+
+size_t Polyline::getMemoryUsage() const {
+    return sizeof(Polyline) + getColorHeapBytes()
+         + coords.capacity() * sizeof(double) + buckets.getHeapUsage();
+}
+
+bool Polyline::isFilled() const {
+    return false;
+}
+
+const EdgeBuckets *Polyline::getBuckets(double margin) const {
+    int n = getVertexCount();
+    if (n < BUCKET_THRESHOLD) return NULL;
+    if (!buckets.isBuilt()) buckets.build(coords.data(), n, closed, margin);
+    return &buckets;
+}
+
+void Polyline::encodeVertices(ByteWriter & out) const {
+    out.writeU32((uint32_t) getVertexCount());
+    for (double v : coords) {
+        out.writeDouble(v);
+    }
+}
+
+// The vertices are read as stored, relative to the location, so that the
+// decoded outline matches the original bit for bit.
+void Polyline::decodeVertices(ByteReader & in) {
+    uint32_t count = in.readU32();
+    if (count > in.remaining() / 16) {
+        throw runtime_error("Polyline: vertex count exceeds the data");
+    }
+    coords.resize(2 * count);
+    for (double & v : coords) {
+        v = in.readDouble();
+    }
+    left = top = right = bottom = 0;
+    if (count > 0) {
+        left = right = coords[0];
+        top = bottom = coords[1];
+    }
+    for (uint32_t k = 1; k < count; k++) {
+        left = min(left, coords[2 * k]);
+        right = max(right, coords[2 * k]);
+        top = min(top, coords[2 * k + 1]);
+        bottom = max(bottom, coords[2 * k + 1]);
+    }
+    buckets.clear();
+}
+
+Polygon::Polygon() : Polyline(true) {
+    rule = NON_ZERO;
+}
+
+Polygon::Polygon(const double *coords, int count) : Polygon() {
+    for (int k = 0; k < count; k++) {
+        addVertex(coords[2 * k], coords[2 * k + 1]);
+    }
+}
+
+Polygon::Polygon(ByteReader & in) : Polygon() {
+    decodeHeader(in);
+    uint8_t code = in.readU8();
+    if (code != EVEN_ODD && code != NON_ZERO) {
+        throw runtime_error("Polygon: unknown fill rule");
+    }
+    rule = (FillRule) code;
+    decodeVertices(in);
+}
+
+void Polygon::setFillRule(FillRule rule) {
+    this->rule = rule;
+    changed();
+}
+
+FillRule Polygon::getFillRule() const {
+    return rule;
+}
+
+void Polygon::draw(RenderTarget & target) {
+    int n = getVertexCount();
+    if (n < 3) return;
+    target.setColor(colorId);
+    target.fillPolygon(coords.data(), n, x, y, rule);
+}
+
+Shape *Polygon::clone() const {
+    Polygon *copy = new Polygon(*this);
+    copy->observer = NULL;
+    return copy;
+}
+
+void Polygon::encode(ByteWriter & out) const {
+    encodeHeader(out, SHAPE_POLYGON);
+    out.writeU8((uint8_t) rule);
+    encodeVertices(out);
+}
+
+bool Polygon::contains(double x, double y) const {
+    int n = getVertexCount();
+    if (n < 3) return false;
+    double qx = x - this->x;
+    double qy = y - this->y;
+    if (qx < left || qx > right || qy < top || qy > bottom) return false;
+    const double *v = coords.data();
+    int crossings = 0;
+    int winding = 0;
+    auto cross = [&](int k) {
+        int m = (k + 1) % n;
+        double y0 = v[2 * k + 1];
+        double y1 = v[2 * m + 1];
+        if ((y0 <= qy) == (y1 <= qy)) return;
+        double x0 = v[2 * k];
+        double xi = x0 + (qy - y0) * (v[2 * m] - x0) / (y1 - y0);
+        if (qx < xi) {
+            crossings++;
+            winding += (y1 > y0) ? 1 : -1;
+        }
+    };
+    const EdgeBuckets *index = getBuckets(0);
+    if (index != NULL) {
+        const int *first, *last;
+        if (!index->find(qy, first, last)) return false;
+        for (const int *p = first; p != last; p++) {
+            cross(*p);
+        }
+    } else {
+        for (int k = 0; k < n; k++) {
+            cross(k);
+        }
+    }
+    return (rule == EVEN_ODD) ? (crossings % 2 == 1) : winding != 0;
+}
+
+GRectangle Polygon::getBounds() const {
+    return GRectangle(x + left, y + top, right - left, bottom - top);
+}
+
+size_t Polygon::getMemoryUsage() const {
+    return Polyline::getMemoryUsage() - sizeof(Polyline) + sizeof(Polygon);
+}
+
+bool Polygon::isFilled() const {
+    return true;
+}
+
+// Implementation notes: ShapeGroup class
+//
+// The group keeps its bounds as edge coordinates rather than a GRectangle
+// so that the rejection tests in draw and contains stay inline.  Children
+// report every change through shapeChanged, which only marks the cache
+// dirty; the union is rebuilt the next time it is needed.  Nested groups
+// answer getBounds from their own caches, so a rebuild touches only the
+// direct children.
+
+ShapeGroup::ShapeGroup() {
+    x = y = 0;
+    batching = false;
+    dirty = false;
+    left = top = right = bottom = 0;
+}
+
+ShapeGroup::~ShapeGroup() {
+    for (Shape *sp : children) {
+        delete sp;
+    }
+}
+
+// The constructor delegates to the default one, so the destructor frees
+// the children already read if decoding fails partway.
+ShapeGroup::ShapeGroup(ByteReader & in) : ShapeGroup() {
+    decodeHeader(in);
+    uint32_t count = in.readU32();
+    for (uint32_t k = 0; k < count; k++) {
+        add(Shape::decode(in));
+    }
+}
+
+void ShapeGroup::add(Shape *sp) {
+    if (sp->getObserver() != NULL) {
+        throw runtime_error("Shape already belongs to a container.");
+    }
+    sp->setObserver(this);
+    children.add(sp);
+    dirty = true;
+    changed();
+}
+
+void ShapeGroup::remove(Shape *sp) {
+    auto it = std::find(children.begin(), children.end(), sp);
+    if (it == children.end()) {
+        throw runtime_error("Shape not found in ShapeGroup.");
+    }
+    children.remove(it - children.begin());
+    sp->setObserver(NULL);
+    dirty = true;
+    changed();
+}
+
+int ShapeGroup::size() const {
+    return children.size();
+}
+
+Shape *ShapeGroup::get(int index) const {
+    return children.get(index);
+}
+
+void ShapeGroup::setLocation(double x, double y) {
+    updateBounds();
+    move(x - left, y - top);
+}
+
+// Translating every child shifts the union by the same amount, so a clean
+// cache stays clean and the group notifies its observer only once.
+void ShapeGroup::move(double dx, double dy) {
+    batching = true;
+    for (Shape *sp : children) {
+        sp->move(dx, dy);
+    }
+    batching = false;
+    left += dx;
+    right += dx;
+    top += dy;
+    bottom += dy;
+    changed();
+}
+
+void ShapeGroup::setColor(const string & color) {
+    this->color = color;
+    colorId = resolveColor(color);
+    batching = true;
+    for (Shape *sp : children) {
+        sp->setColor(color);
+    }
+    batching = false;
+    changed();
+}
+
+GPoint ShapeGroup::getLocation() const {
+    updateBounds();
+    return GPoint(left, top);
+}
+
+void ShapeGroup::draw(RenderTarget & target) {
+    if (children.isEmpty()) return;
+    updateBounds();
+    GRectangle viewport = target.getViewport();
+    if (right < viewport.getX() || bottom < viewport.getY() ||
+        left > viewport.getX() + viewport.getWidth() ||
+        top > viewport.getY() + viewport.getHeight()) return;
+    for (Shape *sp : children) {
+        sp->draw(target);
+    }
+}
+
+// The children are cloned one by one, since a group cannot be copied
+Shape *ShapeGroup::clone() const {
+    ShapeGroup *copy = new ShapeGroup();
+    copy->color = color;
+    copy->colorId = colorId;
+    for (Shape *sp : children) {
+        copy->add(sp->clone());
+    }
+    return copy;
+}
+
+void ShapeGroup::encode(ByteWriter & out) const {
+    encodeHeader(out, SHAPE_GROUP);
+    out.writeU32((uint32_t) children.size());
+    for (Shape *sp : children) {
+        sp->encode(out);
+    }
+}
+
+bool ShapeGroup::contains(double x, double y) const {
+    if (children.isEmpty()) return false;
+    updateBounds();
+    if (x < left || x > right || y < top || y > bottom) return false;
+    int visited = 0;
+    bool found = false;
+    for (Shape *sp : children) {
+        visited++;
+        if (sp->contains(x, y)) {
+            found = true;
+            break;
+        }
+    }
+    INSTRUMENT_COUNT(PROBE_SHAPE_CONTAINS, visited, 0, 0);
+    return found;
+}
+
+GRectangle ShapeGroup::getBounds() const {
+    updateBounds();
+    return GRectangle(left, top, right - left, bottom - top);
+}
+
+size_t ShapeGroup::getMemoryUsage() const {
+    size_t bytes = sizeof(ShapeGroup) + getColorHeapBytes()
+                 + children.getMemoryUsage() - sizeof(children);
+    for (Shape *sp : children) {
+        bytes += sp->getMemoryUsage();
+    }
+    return bytes;
+}
+
+void ShapeGroup::shapeChanged(Shape *) {
+    if (batching) return;
+    dirty = true;
+    changed();
+}
 
-    return ((x - h)*(x - h)/(a*a) + (y - k)*(y - k)/(b*b)) <= 1;
+void ShapeGroup::updateBounds() const {
+    if (!dirty) return;
+    dirty = false;
+    left = top = right = bottom = 0;
+    bool first = true;
+    for (Shape *sp : children) {
+        GRectangle r = sp->getBounds();
+        if (first) {
+            left = r.getX();
+            top = r.getY();
+            right = left + r.getWidth();
+            bottom = top + r.getHeight();
+            first = false;
+        } else {
+            left = min(left, r.getX());
+            top = min(top, r.getY());
+            right = max(right, r.getX() + r.getWidth());
+            bottom = max(bottom, r.getY() + r.getHeight());
+        }
+    }
 }
 /*
 int main() {
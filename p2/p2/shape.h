@@ -2,30 +2,114 @@
 #define SHAPE_H
 
 #include "gwindow.h"
+#include "gtypes.h"
+#include "rendertarget.h"
+#include "scanline.h"
+#include <cstddef>
 #include <string>
+#include <vector>
+
+class Shape;
+class ByteWriter;
+class ByteReader;
+
+/*
+ * Type: ShapeType
+ * ---------------
+ * The tag that encode writes first, identifying the class of the shape.
+ */
+enum ShapeType {
+    SHAPE_LINE = 1,
+    SHAPE_SQUARE,
+    SHAPE_RECT,
+    SHAPE_OVAL,
+    SHAPE_POLYLINE,
+    SHAPE_POLYGON,
+    SHAPE_GROUP
+};
+
+/*
+ * Class: ShapeObserver
+ * --------------------
+ * Receives a notification whenever an observed shape changes its location,
+ * extent or color.  A shape has at most one observer, which is normally
+ * the container holding it.
+ */
+class ShapeObserver {
+public:
+    virtual ~ShapeObserver() {}
+    virtual void shapeChanged(Shape *sp) = 0;
+};
 
 class Shape {
 public:
+    virtual ~Shape() {}
     virtual void setLocation(double x, double y);
     virtual void move(double x, double y);
     virtual void setColor(const std::string& color);
-    virtual void draw(GWindow& gw) = 0;
+    // Sets a resolved color, named in the form "#rrggbb", which is short
+    // enough to be stored without allocating; signals an error if invalid
+    void setColor(ColorId color);
+    // Returns the point that setLocation would move back to where it is now
+    virtual GPoint getLocation() const;
+    virtual void draw(RenderTarget & target) = 0;
+    // Draws on a window through a WindowTarget; subclasses that override
+    // draw bring this into scope with a using-declaration
+    void draw(GWindow & gw);
     virtual bool contains(double x, double y) const= 0;
+    // Returns the smallest rectangle enclosing every point the shape contains
+    virtual GRectangle getBounds() const = 0;
+    // Returns false for shapes that stroke a path rather than fill an area
+    virtual bool isFilled() const;
+    const std::string & getColor() const;
+    // Returns the color resolved once by setColor
+    ColorId getColorId() const;
+    // Returns the bytes the shape occupies, counting its color string and
+    // every other block of memory it owns
+    virtual size_t getMemoryUsage() const = 0;
+
+    void setObserver(ShapeObserver *observer);
+    ShapeObserver *getObserver() const;
+
+    // Returns a deep copy of the shape that has no observer
+    virtual Shape *clone() const = 0;
+    // Appends the type, location, color and geometry of the shape to out
+    virtual void encode(ByteWriter & out) const = 0;
+    // Creates a shape from data written by encode; the copy is exact, so
+    // encoding it again produces the same bytes
+    static Shape *decode(ByteReader & in);
 
 protected:
     Shape();
+    // Notifies the observer, if any; called after every mutation
+    void changed();
+    void encodeHeader(ByteWriter & out, ShapeType type) const;
+    // Reads the location and color without notifying the observer
+    void decodeHeader(ByteReader & in);
+    size_t getColorHeapBytes() const;
     std::string color;
+    ColorId colorId;
     double x, y;
+    ShapeObserver *observer;
 };
 
 class Line : public Shape {
 public:
     Line(double x1, double y1, double x2, double y2);
-    virtual void draw(GWindow& gw);
+    explicit Line(ByteReader & in);
+    using Shape::draw;
+    virtual void draw(RenderTarget & target);
+    virtual Shape *clone() const;
+    virtual void encode(ByteWriter & out) const;
     virtual bool contains(double x, double y) const ;
+    virtual GRectangle getBounds() const;
+    virtual size_t getMemoryUsage() const;
+    virtual bool isFilled() const;
 private:
     double dx;
     double dy;
+    // 1 / (dx*dx + dy*dy), or 0 for a zero-length line
+    double invNorm;
 };
 
 
@@ -33,8 +117,16 @@ class Square : public Shape {
 public:
     // Constructor for Square which takes x, y coordinates of the upper left corner and size
     Square(double x, double y, double size);
-    virtual void draw(GWindow& gw);
+    explicit Square(ByteReader & in);
+    // Changes the side length, keeping the upper left corner in place
+    void setSize(double size);
+    using Shape::draw;
+    virtual void draw(RenderTarget & target);
+    virtual Shape *clone() const;
+    virtual void encode(ByteWriter & out) const;
     virtual bool contains(double x, double y) const ; 
+    virtual GRectangle getBounds() const;
+    virtual size_t getMemoryUsage() const;
 
 private:
     // Side length of the square
@@ -45,8 +137,16 @@ class Rect : public Shape {
 public:
     // Constructor for Rect which takes x, y coordinates of the upper left corner and size
     Rect(double x, double y, double width, double height);
-    virtual void draw(GWindow& gw);
+    explicit Rect(ByteReader & in);
+    // Changes the size, keeping the upper left corner in place
+    void setSize(double width, double height);
+    using Shape::draw;
+    virtual void draw(RenderTarget & target);
+    virtual Shape *clone() const;
+    virtual void encode(ByteWriter & out) const;
     virtual bool contains(double x, double y) const ;
+    virtual GRectangle getBounds() const;
+    virtual size_t getMemoryUsage() const;
 
 private:
     // Side length of the square
@@ -58,12 +158,148 @@ class Oval : public Shape {
 public:
     // Constructor for Oval which takes x, y coordinates of the upper left corner and size
     Oval(double x, double y, double width, double height);
-    virtual void draw(GWindow& gw);
+    explicit Oval(ByteReader & in);
+    // Changes the size of the bounding box, keeping its upper left corner
+    void setSize(double width, double height);
+    virtual void setLocation(double x, double y);
+    virtual void move(double x, double y);
+    using Shape::draw;
+    virtual void draw(RenderTarget & target);
+    virtual Shape *clone() const;
+    virtual void encode(ByteWriter & out) const;
     virtual bool contains(double x, double y) const ;
+    virtual GRectangle getBounds() const;
+    virtual size_t getMemoryUsage() const;
 private:
     // Side length of the square
     double width;
     double height;
-}; 
+    // Center, kept in step with (x, y) so contains needs no divisions
+    double cx, cy;
+    // Inverse squared semi-axes, or 0 if the oval has no area
+    double invA2, invB2;
+    void updateAxes();
+};
+
+/*
+ * Class: Polyline
+ * ---------------
+ * An open path through a sequence of vertices, drawn as connected lines
+ * and hit with the same half-pixel tolerance as Line.  The vertices are
+ * stored contiguously relative to the first one, which is the location of
+ * the shape, so moving the shape does not touch them.  Paths with many
+ * vertices index their edges by y on the first call to contains, after
+ * which a hit test examines only the edges near the query point.  That
+ * first call must not race with other calls on the same shape.
+ */
+class Polyline : public Shape {
+public:
+    Polyline();
+    // Creates a path through count vertices given as x0, y0, x1, y1, ...
+    Polyline(const double *coords, int count);
+    explicit Polyline(ByteReader & in);
+    void addVertex(double x, double y);
+    int getVertexCount() const;
+    using Shape::draw;
+    virtual void draw(RenderTarget & target);
+    virtual Shape *clone() const;
+    virtual void encode(ByteWriter & out) const;
+    virtual bool contains(double x, double y) const;
+    virtual GRectangle getBounds() const;
+    virtual size_t getMemoryUsage() const;
+    virtual bool isFilled() const;
+
+protected:
+    // Creates an empty outline whose last vertex joins the first if closed
+    explicit Polyline(bool closed);
+    // Returns the edge index, building it first if necessary
+    const EdgeBuckets *getBuckets(double margin) const;
+    void encodeVertices(ByteWriter & out) const;
+    void decodeVertices(ByteReader & in);
+
+    std::vector<double> coords;    // Vertices relative to (x, y)
+    double left, top, right, bottom;
+    bool closed;
+
+private:
+    mutable EdgeBuckets buckets;
+};
+
+/*
+ * Class: Polygon
+ * --------------
+ * A closed outline filled according to a FillRule, NON_ZERO by default.
+ * Polygons are rasterized with an active-edge table, and contains counts
+ * the crossings of a ray from the query point with the edges near it.
+ */
+class Polygon : public Polyline {
+public:
+    Polygon();
+    // Creates a polygon with count vertices given as x0, y0, x1, y1, ...
+    Polygon(const double *coords, int count);
+    explicit Polygon(ByteReader & in);
+    void setFillRule(FillRule rule);
+    FillRule getFillRule() const;
+    using Polyline::draw;
+    virtual void draw(RenderTarget & target);
+    virtual Shape *clone() const;
+    virtual void encode(ByteWriter & out) const;
+    virtual bool contains(double x, double y) const;
+    virtual GRectangle getBounds() const;
+    virtual size_t getMemoryUsage() const;
+    virtual bool isFilled() const;
+
+private:
+    FillRule rule;
+};
+
+/*
+ * Class: ShapeGroup
+ * -----------------
+ * A composite shape that owns a list of child shapes, drawn back to front
+ * like a ShapeList.  The group caches the union of its children's bounds
+ * so that draw and contains can reject the whole subtree with a single
+ * rectangle test.  Nesting groups therefore forms a bounding-volume
+ * hierarchy.  The cache is recomputed lazily, only after a child reports
+ * a change.  Deleting the group deletes its children.
+ */
+class ShapeGroup : public Shape, public ShapeObserver {
+public:
+    ShapeGroup();
+    virtual ~ShapeGroup();
+    explicit ShapeGroup(ByteReader & in);
+
+    // Adds sp to the front of the group, which takes ownership of it
+    void add(Shape *sp);
+    // Removes sp from the group and returns ownership to the caller
+    void remove(Shape *sp);
+    int size() const;
+    Shape *get(int index) const;
+
+    virtual void setLocation(double x, double y);
+    virtual void move(double dx, double dy);
+    using Shape::setColor;
+    virtual void setColor(const std::string& color);
+    // The location of a group is the top-left corner of its bounds
+    virtual GPoint getLocation() const;
+    using Shape::draw;
+    virtual void draw(RenderTarget & target);
+    virtual Shape *clone() const;
+    virtual void encode(ByteWriter & out) const;
+    virtual bool contains(double x, double y) const;
+    virtual GRectangle getBounds() const;
+    virtual size_t getMemoryUsage() const;
+    virtual void shapeChanged(Shape *sp);
+
+private:
+    ShapeGroup(const ShapeGroup & src);
+    ShapeGroup & operator=(const ShapeGroup & src);
+    void updateBounds() const;
+
+    Vector<Shape *> children;
+    bool batching;                 // Suppresses child notifications
+    mutable bool dirty;            // True if the cached bounds are stale
+    mutable double left, top, right, bottom;
+};
 
 #endif // SHAPE_H
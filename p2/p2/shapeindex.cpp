@@ -0,0 +1,165 @@
+/*
+ * File: shapeindex.cpp
+ * --------------------
+ * This file implements the ShapeIndex class.
+ */
+
+#include "shapeindex.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+/*
+ * Implementation notes: strOrder
+ * ------------------------------
+ * Sort-Tile-Recursive arranges n boxes so that every run of NODE_SIZE
+ * consecutive boxes is spatially compact: it sorts the boxes by the x
+ * coordinate of their centers, cuts them into about sqrt(n / NODE_SIZE)
+ * vertical slices of whole nodes, and sorts each slice by y. The slices
+ * are independent, so they are sorted in parallel.
+ */
+template <typename Item>
+void strOrder(vector<Item> & items, int nodeSize, int threadCount) {
+    int n = (int) items.size();
+    int leaves = (n + nodeSize - 1) / nodeSize;
+    int slices = (int) ceil(sqrt((double) leaves));
+    int sliceSize = slices * nodeSize;
+    parallelSort(items.begin(), items.end(),
+                 [](const Item & a, const Item & b) {
+                     return a.left + a.right < b.left + b.right;
+                 }, threadCount);
+    parallelFor(slices, threadCount, [&](int begin, int end) {
+        for (int s = begin; s < end; s++) {
+            int first = min(n, s * sliceSize);
+            int last = min(n, first + sliceSize);
+            sort(items.begin() + first, items.begin() + last,
+                 [](const Item & a, const Item & b) {
+                     return a.top + a.bottom < b.top + b.bottom;
+                 });
+        }
+    }, 1);
+}
+
+}
+
+ShapeIndex::ShapeIndex() {
+    generation = 0;
+}
+
+void ShapeIndex::build(const ShapeList & shapes, int threadCount) {
+    clear();
+    int n = shapes.size();
+    entries.resize(n);
+    parallelFor(n, threadCount, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            GRectangle r = shapes[i]->getBounds();
+            entries[i] = { r.getX(), r.getY(), r.getX() + r.getWidth(),
+                           r.getY() + r.getHeight(), i, 0 };
+        }
+    });
+    buildLevels(threadCount);
+    if (n > 0) generation = shapes.getGeneration();
+}
+
+void ShapeIndex::build(const vector<GRectangle> & bounds, int threadCount) {
+    clear();
+    int n = (int) bounds.size();
+    entries.resize(n);
+    parallelFor(n, threadCount, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const GRectangle & r = bounds[i];
+            entries[i] = { r.getX(), r.getY(), r.getX() + r.getWidth(),
+                           r.getY() + r.getHeight(), i, 0 };
+        }
+    });
+    buildLevels(threadCount);
+}
+
+void ShapeIndex::clear() {
+    entries.clear();
+    levels.clear();
+    generation = 0;
+}
+
+int ShapeIndex::size() const {
+    return (int) entries.size();
+}
+
+bool ShapeIndex::isEmpty() const {
+    return entries.empty();
+}
+
+uint64_t ShapeIndex::getGeneration() const {
+    return generation;
+}
+
+// Packs each level in STR order into the nodes of the next, up to the root
+void ShapeIndex::buildLevels(int threadCount) {
+    if (entries.empty()) return;
+    strOrder(entries, NODE_SIZE, threadCount);
+    const vector<Box> *below = &entries;
+    while (levels.empty() || levels.back().size() > 1) {
+        if (!levels.empty()) strOrder(levels.back(), NODE_SIZE, threadCount);
+        int n = (int) below->size();
+        vector<Box> level((n + NODE_SIZE - 1) / NODE_SIZE);
+        parallelFor((int) level.size(), threadCount, [&](int begin, int end) {
+            for (int k = begin; k < end; k++) {
+                int first = k * NODE_SIZE;
+                int count = min(NODE_SIZE, n - first);
+                Box node = { INFINITY, INFINITY, -INFINITY, -INFINITY,
+                             first, count };
+                for (int i = first; i < first + count; i++) {
+                    const Box & child = (*below)[i];
+                    node.left = min(node.left, child.left);
+                    node.top = min(node.top, child.top);
+                    node.right = max(node.right, child.right);
+                    node.bottom = max(node.bottom, child.bottom);
+                }
+                level[k] = node;
+            }
+        }, 256);
+        levels.push_back(std::move(level));
+        below = &levels.back();
+    }
+}
+
+void ShapeIndex::query(double left, double top, double right, double bottom,
+                       vector<int> & result) const {
+    if (levels.empty()) return;
+    struct Visit {
+        int level, index;
+    };
+    vector<Visit> stack;
+    stack.push_back({ (int) levels.size() - 1, 0 });
+    while (!stack.empty()) {
+        Visit visit = stack.back();
+        stack.pop_back();
+        const Box & node = levels[visit.level][visit.index];
+        if (!(node.left <= right && node.right >= left
+              && node.top <= bottom && node.bottom >= top)) {
+            continue;
+        }
+        int last = node.first + node.count;
+        if (visit.level > 0) {
+            for (int i = node.first; i < last; i++) {
+                stack.push_back({ visit.level - 1, i });
+            }
+        } else {
+            for (int i = node.first; i < last; i++) {
+                const Box & entry = entries[i];
+                if (entry.left <= right && entry.right >= left
+                    && entry.top <= bottom && entry.bottom >= top) {
+                    result.push_back(entry.first);
+                }
+            }
+        }
+    }
+}
+
+void ShapeIndex::queryPoint(double x, double y, vector<int> & result) const {
+    query(x, y, x, y, result);
+}
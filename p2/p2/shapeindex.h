@@ -0,0 +1,82 @@
+/*
+* File: shapeindex.h
+* ------------------
+* This file defines a ShapeIndex class, an R-tree over the bounds of the
+* shapes in a ShapeList that is built in one pass rather than by inserting
+* the shapes one at a time.
+*/
+#ifndef _shapeindex_h
+#define _shapeindex_h
+#include <cstdint>
+#include <vector>
+#include "gtypes.h"
+#include "shapelist.h"
+/*
+* Class: ShapeIndex
+* -----------------
+* A static R-tree that finds the shapes whose bounds meet a point or a
+* rectangle, identified by their index in the list it was built from. The
+* tree is bulk-loaded with the Sort-Tile-Recursive algorithm, which sorts
+* the shapes into tiles of neighbors and packs every node full, in
+* O(n log n) time with the sorts spread across threads. The index does not
+* follow later changes to the list; getGeneration tells whether it still
+* describes it.
+*/
+class ShapeIndex {
+public:
+ShapeIndex();
+/*
+* Method: build
+* Usage: index.build(shapes);
+* index.build(bounds);
+* ---------------------
+* Replaces the contents of the index with the bounds of every shape in
+* shapes, or with the rectangles in bounds, using at most threadCount
+* threads, or as many as the hardware runs at once if threadCount is 0.
+*/
+void build(const ShapeList & shapes, int threadCount = 0);
+void build(const std::vector<GRectangle> & bounds, int threadCount = 0);
+void clear();
+int size() const;
+bool isEmpty() const;
+/*
+* Method: getGeneration
+* Usage: if (index.getGeneration() != shapes.getGeneration()) ...
+* ---------------------------------------------------------------
+* Returns the generation of the list when the index was built from it, or
+* 0 if the index was built from rectangles or is empty.
+*/
+uint64_t getGeneration() const;
+/*
+* Methods: query, queryPoint
+* Usage: index.query(left, top, right, bottom, result);
+* index.queryPoint(x, y, result);
+* -------------------------------
+* Append to result, in no particular order, the index of every shape
+* whose bounds intersect the rectangle or contain the point. Bounds
+* include their edges.
+*/
+void query(double left, double top, double right, double bottom,
+std::vector<int> & result) const;
+void queryPoint(double x, double y, std::vector<int> & result) const;
+private:
+/*
+* Implementation notes: ShapeIndex
+* --------------------------------
+* The tree is stored level by level. The nodes of levels[0] cover runs of
+* entries, those of each higher level cover runs of nodes in the level
+* below, and the last level holds only the root. A node's children are
+* the count items starting at first in the level below it.
+*/
+static constexpr int NODE_SIZE = 16;
+struct Box {
+double left, top, right, bottom;
+int first;                    // Shape index for an entry
+int count;                    // Unused for an entry
+};
+void buildLevels(int threadCount);
+std::vector<Box> entries;
+std::vector<std::vector<Box> > levels;
+uint64_t generation;
+};
+#endif
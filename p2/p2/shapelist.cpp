@@ -1,29 +1,247 @@
 #include "shapelist.h"
+#include "instrument.h"
+#include "shapeindex.h"
 #include <algorithm> 
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+ShapeList::ShapeList() {
+    detailThreshold = 1;
+    occlusionCulling = true;
+    generation = 1;
+    hitQuantum = 0;
+    for (HitEntry & entry : hitCache) {
+        entry = { 0, 0, 0, nullptr };
+    }
+    hitCacheHits = hitCacheMisses = 0;
+    scanGeneration = scanVisited = 0;
+    listener = nullptr;
+    updateDepth = 0;
+    updateChanged = false;
+    positionsValid = false;
+    freezing = false;
+}
+
+ShapeList::~ShapeList() {
+    for (Shape *sp : *this) {
+        if (sp->getObserver() == this) sp->setObserver(nullptr);
+    }
+}
+
+void ShapeList::add(Shape *sp) {
+    attach(sp);
+    Vector<Shape *>::add(sp);
+    freeze(size() - 1, sp);
+    bump();
+    if (listener != nullptr) listener->shapeInserted(size() - 1, sp);
+}
+
+void ShapeList::addAll(Shape *const *array, int count) {
+    for (int i = 0; i < count; i++) {
+        ShapeObserver *current = array[i]->getObserver();
+        if (current != nullptr && current != this) {
+            throw std::runtime_error("Shape already belongs to a container.");
+        }
+    }
+    ensureCapacity(size() + count);
+    beginUpdate();
+    for (int i = 0; i < count; i++) {
+        add(array[i]);
+    }
+    endUpdate();
+}
+
+void ShapeList::push_back(Shape *sp) {
+    add(sp);
+}
+
+void ShapeList::insert(int index, Shape *sp) {
+    attach(sp);
+    Vector<Shape *>::insert(index, sp);
+    freeze(index, sp);
+    bump();
+    if (listener != nullptr) listener->shapeInserted(index, sp);
+}
+
+void ShapeList::set(int index, Shape *sp) {
+    Shape *old = get(index);
+    attach(sp);
+    Vector<Shape *>::set(index, sp);
+    detach(old);
+    if (freezing) {
+        frozen.set(index, nullptr);
+        stale.insert(sp);
+        if (positionsValid) {
+            forgetPosition(old, index);
+            positions.emplace(sp, index);
+        }
+    }
+    bump();
+    if (listener != nullptr) {
+        listener->shapeRemoved(index, old);
+        listener->shapeInserted(index, sp);
+    }
+}
+
+void ShapeList::remove(int index) {
+    Shape *old = get(index);
+    Vector<Shape *>::remove(index);
+    detach(old);
+    if (freezing) {
+        frozen.remove(index);
+        if (index != size()) {
+            positionsValid = false;
+        } else if (positionsValid) {
+            forgetPosition(old, index);
+        }
+    }
+    bump();
+    if (listener != nullptr) listener->shapeRemoved(index, old);
+}
+
+void ShapeList::clear() {
+    for (Shape *sp : *this) {
+        if (sp->getObserver() == this) sp->setObserver(nullptr);
+    }
+    Vector<Shape *>::clear();
+    frozen.clear();
+    stale.clear();
+    positions.clear();
+    positionsValid = true;
+    bump();
+    if (listener != nullptr) listener->shapesCleared();
+}
+
+Shape *ShapeList::operator[](int index) const {
+    return get(index);
+}
+
+void ShapeList::shapeChanged(Shape *sp) {
+    if (freezing) stale.insert(sp);
+    bump();
+    if (listener != nullptr) listener->shapeUpdated(sp);
+}
+
+void ShapeList::setListener(ShapeListListener *listener) {
+    this->listener = listener;
+}
+
+ShapeListListener *ShapeList::getListener() const {
+    return listener;
+}
+
+uint64_t ShapeList::getGeneration() const {
+    return generation;
+}
+
+void ShapeList::attach(Shape *sp) {
+    ShapeObserver *current = sp->getObserver();
+    if (current != nullptr && current != this) {
+        throw std::runtime_error("Shape already belongs to a container.");
+    }
+    sp->setObserver(this);
+}
+
+// A shape may appear in the list more than once, so the list stays its
+// observer until the last copy is gone.
+void ShapeList::detach(Shape *sp) {
+    if (sp->getObserver() == this && std::find(begin(), end(), sp) == end()) {
+        sp->setObserver(nullptr);
+    }
+}
+
+void ShapeList::beginUpdate() {
+    updateDepth++;
+}
+
+void ShapeList::endUpdate() {
+    if (updateDepth == 0) {
+        throw std::runtime_error("endUpdate without beginUpdate");
+    }
+    if (--updateDepth == 0 && updateChanged) {
+        updateChanged = false;
+        generation++;
+    }
+}
+
+// Within an update group the generation is advanced by endUpdate
+void ShapeList::bump() {
+    if (updateDepth > 0) {
+        updateChanged = true;
+    } else {
+        generation++;
+    }
+}
+
+void ShapeList::reordered(int from, int to) {
+    if (freezing && from != to) {
+        std::shared_ptr<Shape> copy = frozen[from];
+        frozen.remove(from);
+        frozen.insert(to, copy);
+        positionsValid = false;
+    }
+    bump();
+    if (listener != nullptr && from != to) listener->shapeReordered(from, to);
+}
+
+// The copy is made when the next snapshot is taken
+void ShapeList::freeze(int index, Shape *sp) {
+    if (freezing) {
+        frozen.insert(index, nullptr);
+        stale.insert(sp);
+        if (index != size() - 1) {
+            positionsValid = false;
+        } else if (positionsValid) {
+            positions.emplace(sp, index);
+        }
+    }
+}
+
+void ShapeList::forgetPosition(Shape *sp, int index) {
+    auto range = positions.equal_range(sp);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == index) {
+            positions.erase(it);
+            return;
+        }
+    }
+}
 
 void ShapeList::moveToFront(Shape *sp) {
+    INSTRUMENT_SCOPE(PROBE_MOVE_TO_FRONT);
     auto it = std::find(begin(), end(), sp);
     if (it != end()) {
+        int from = it - begin();
         std::rotate(it, it + 1, end());
+        reordered(from, size() - 1);
     } else {
         throw std::runtime_error("Shape not found in ShapeList.");
     }
 }
 
 void ShapeList::moveToBack(Shape *sp) {
+    INSTRUMENT_SCOPE(PROBE_MOVE_TO_BACK);
     auto it = std::find(begin(), end(), sp);
     if (it != end()) {
+        int from = it - begin();
         std::rotate(begin(), it, it + 1);
+        reordered(from, 0);
     } else {
         throw std::runtime_error("Shape not found in ShapeList.");
     }
 }
 
 void ShapeList::moveForward(Shape *sp) {
+    INSTRUMENT_SCOPE(PROBE_MOVE_FORWARD);
     auto it = std::find(begin(), end(), sp);
     if (it != end()) {
         if (it + 1 != end()) { // Not already at the front
             std::iter_swap(it, it + 1);
+            reordered(it - begin(), it - begin() + 1);
         }
     } else {
         throw std::runtime_error("Shape not found in ShapeList.");
@@ -31,27 +249,493 @@ void ShapeList::moveForward(Shape *sp) {
 }
 
 void ShapeList::moveBackward(Shape *sp) {
+    INSTRUMENT_SCOPE(PROBE_MOVE_BACKWARD);
     auto it = std::find(begin(), end(), sp);
     if (it != end()) {
         if (it != begin()) { // Not already at the back
             std::iter_swap(it, it - 1);
+            reordered(it - begin(), it - begin() - 1);
         }
     } else {
         throw std::runtime_error("Shape not found in ShapeList.");
     }
 }
 
-void ShapeList::draw(GWindow & gw) const {
-    for (Shape *shape : *this) {
-        shape->draw(gw);
+void ShapeList::moveTo(Shape *sp, int index) {
+    auto it = std::find(begin(), end(), sp);
+    if (it == end()) {
+        throw std::runtime_error("Shape not found in ShapeList.");
     }
+    if (index < 0 || index >= size()) {
+        throw std::runtime_error("moveTo: index out of range");
+    }
+    int from = it - begin();
+    if (from < index) {
+        std::rotate(it, it + 1, begin() + index + 1);
+    } else {
+        std::rotate(begin() + index, it, it + 1);
+    }
+    reordered(from, index);
+}
+
+namespace {
+
+// Settles the lazily computed bounds of groups before the copy is shared,
+// so that threads drawing the snapshot only read it.
+std::shared_ptr<Shape> frozenCopy(const Shape *sp) {
+    std::shared_ptr<Shape> copy(sp->clone());
+    copy->getBounds();
+    return copy;
+}
+
+}
+
+SceneSnapshot ShapeList::snapshot() const {
+    if (!freezing) {
+        for (Shape *sp : *this) {
+            frozen.add(frozenCopy(sp));
+        }
+        stale.clear();
+        positions.clear();
+        positionsValid = false;
+        freezing = true;
+    } else if (!stale.empty()) {
+        if (!positionsValid) {
+            positions.clear();
+            positions.reserve(size());
+            for (int i = 0; i < size(); i++) {
+                positions.emplace(get(i), i);
+            }
+            positionsValid = true;
+        }
+        // Removed shapes may still be stale but have no positions
+        for (Shape *sp : stale) {
+            auto range = positions.equal_range(sp);
+            for (auto it = range.first; it != range.second; ++it) {
+                frozen.set(it->second, frozenCopy(sp));
+            }
+        }
+        stale.clear();
+    }
+    SceneSnapshot result;
+    result.shapes = frozen;
+    result.detailThreshold = detailThreshold;
+    result.occlusionCulling = occlusionCulling;
+    result.generation = generation;
+    return result;
+}
+
+/*
+* Implementation notes: draw
+* --------------------------
+* Shapes below the detail threshold are not drawn immediately. Each one is
+* recorded against the target pixel under its center, overwriting any
+* earlier reduced shape on that pixel, and the collected pixels are
+* flushed just before the next full-size shape is drawn and at the end.
+* This keeps the back-to-front order intact while plotting every pixel at
+* most once per run of reduced shapes, so the cost of a zoomed-out scene
+* is bounded by the number of pixels it covers rather than the number of
+* shapes. Sizes are measured in pixels of the target, which on a target
+* that scales the scene are getPixelSize scene units wide. Groups are
+* never reduced as a whole; the test is applied to each of their children.
+*/
+namespace {
+
+struct DetailPixel {
+    double x, y;
+    const Shape *shape;
+};
+
+class DetailPixels {
+public:
+    // Pixels are pixelSize scene units wide
+    explicit DetailPixels(double pixelSize) {
+        this->pixelSize = pixelSize;
+    }
+
+    void plot(double x, double y, const Shape *shape) {
+        double px = std::floor(x / pixelSize);
+        double py = std::floor(y / pixelSize);
+        long long key = ((long long) px << 32) ^ (unsigned int) (int) py;
+        auto result = index.emplace(key, (int) pixels.size());
+        if (result.second) {
+            pixels.push_back({ px * pixelSize, py * pixelSize, shape });
+        } else {
+            pixels[result.first->second].shape = shape;
+        }
+    }
+
+    // Each run of pixels in one color goes to the target as one batch
+    void flush(RenderTarget & target) {
+        ColorId current;
+        for (const DetailPixel & pixel : pixels) {
+            ColorId color = pixel.shape->getColorId();
+            if (!current.isValid() || current != color) {
+                fillRun(target);
+                target.setColor(color);
+                current = color;
+            }
+            run.push_back(GRectangle(pixel.x, pixel.y, pixelSize, pixelSize));
+        }
+        fillRun(target);
+        pixels.clear();
+        index.clear();
+    }
+
+private:
+    void fillRun(RenderTarget & target) {
+        if (run.empty()) return;
+        target.fillRects(run.data(), (int) run.size());
+        run.clear();
+    }
+
+    double pixelSize;
+    std::vector<DetailPixel> pixels;
+    std::unordered_map<long long, int> index;
+    std::vector<GRectangle> run;
+};
+
+// Lists hold raw pointers and snapshots shared ones
+Shape *asShape(Shape *shape) {
+    return shape;
+}
+
+Shape *asShape(const std::shared_ptr<Shape> & shape) {
+    return shape.get();
+}
+
+/*
+ * Implementation notes: occlusion culling
+ * ---------------------------------------
+ * Before drawing, the shapes are visited from front to back against a
+ * mask of cells, CELL pixels of the target on a side, covering the
+ * viewport. A filled Rect or Square marks every cell lying wholly within
+ * the pixels it paints solidly, and a shape whose bounds, widened by a
+ * pixel for antialiased edges, touch only marked cells is hidden by
+ * shapes in front of it and is skipped. Occluders below the detail
+ * threshold mark nothing, since they are plotted as a single pixel rather
+ * than painted across their bounds. The mask is coarse, so partly covered
+ * cells never hide anything and the test only ever errs toward drawing.
+ */
+class CoverageMask {
+public:
+    static const int CELL = 8;
+
+    // The viewport is the part of the scene the target shows
+    CoverageMask(const GRectangle & viewport, double pixelSize) {
+        originX = viewport.getX();
+        originY = viewport.getY();
+        pixel = pixelSize;
+        cell = CELL * pixelSize;
+        columns = std::max(0, (int) std::ceil(viewport.getWidth() / cell));
+        rows = std::max(0, (int) std::ceil(viewport.getHeight() / cell));
+        cells.assign((size_t) columns * rows, false);
+        empty = true;
+    }
+
+    // Interior pixels of a filled rectangle are painted without blending
+    void cover(const GRectangle & r) {
+        double x = r.getX() - originX;
+        double y = r.getY() - originY;
+        int c0 = std::max(0, (int) std::ceil(x / cell));
+        int r0 = std::max(0, (int) std::ceil(y / cell));
+        int c1 = std::min(columns, (int) std::floor((x + r.getWidth()) / cell));
+        int r1 = std::min(rows, (int) std::floor((y + r.getHeight()) / cell));
+        for (int row = r0; row < r1; row++) {
+            for (int col = c0; col < c1; col++) {
+                cells[(size_t) row * columns + col] = true;
+                empty = false;
+            }
+        }
+    }
+
+    bool covers(const GRectangle & r) const {
+        if (empty) return false;
+        double x = r.getX() - originX;
+        double y = r.getY() - originY;
+        int c0 = (int) std::floor((x - pixel) / cell);
+        int r0 = (int) std::floor((y - pixel) / cell);
+        int c1 = (int) std::floor((x + r.getWidth() + pixel) / cell);
+        int r1 = (int) std::floor((y + r.getHeight() + pixel) / cell);
+        if (c0 < 0 || r0 < 0 || c1 >= columns || r1 >= rows) return false;
+        for (int row = r0; row <= r1; row++) {
+            for (int col = c0; col <= c1; col++) {
+                if (!cells[(size_t) row * columns + col]) return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    double originX, originY;     // Whole pixels, so cells align to pixels
+    double pixel, cell;          // Sizes in scene units
+    int columns, rows;
+    std::vector<bool> cells;
+    bool empty;
+};
+
+bool isOccluder(const Shape *shape) {
+    return shape->isFilled() && (dynamic_cast<const Rect *>(shape) != nullptr
+                                 || dynamic_cast<const Square *>(shape) != nullptr);
+}
+
+// Shapes below the threshold, in scene units, are plotted as one pixel
+bool isBelowDetail(const Shape *shape, const GRectangle & bounds,
+                   double threshold) {
+    if (threshold <= 0) return false;
+    double width = bounds.getWidth();
+    double height = bounds.getHeight();
+    if (!shape->isFilled()) {
+        // Stroked bounds include the one-pixel pen
+        width -= 1;
+        height -= 1;
+    }
+    return width < threshold && height < threshold;
+}
+
+/*
+ * Draws one shape, or records it in reduced if it is below the threshold.
+ * A group is never reduced as a whole, since its own color is not drawn:
+ * its children are visited in drawing order, so each is reduced or drawn
+ * on its own merits.
+ */
+void drawShape(Shape *shape, RenderTarget & target, DetailPixels & reduced,
+               double threshold, const GRectangle & viewport) {
+    if (threshold > 0) {
+        GRectangle bounds = shape->getBounds();
+        ShapeGroup *group = dynamic_cast<ShapeGroup *>(shape);
+        if (group != nullptr) {
+            if (bounds.getX() + bounds.getWidth() < viewport.getX()
+                || bounds.getY() + bounds.getHeight() < viewport.getY()
+                || bounds.getX() > viewport.getX() + viewport.getWidth()
+                || bounds.getY() > viewport.getY() + viewport.getHeight()) {
+                return;
+            }
+            for (int i = 0; i < group->size(); i++) {
+                drawShape(group->get(i), target, reduced, threshold, viewport);
+            }
+            return;
+        }
+        if (isBelowDetail(shape, bounds, threshold)) {
+            if (shape->isFilled()) {
+                reduced.plot(bounds.getX() + bounds.getWidth() / 2,
+                             bounds.getY() + bounds.getHeight() / 2, shape);
+            }
+            return;
+        }
+    }
+    reduced.flush(target);
+    shape->draw(target);
+}
+
+template <typename Range>
+void drawShapes(const Range & shapes, int count, RenderTarget & target,
+                double detailThreshold, bool occlusionCulling) {
+    INSTRUMENT_SCOPE(PROBE_SHAPELIST_DRAW);
+    INSTRUMENT_ITEMS(count);
+    // The threshold is in pixels of the target, which may scale the scene
+    double pixelSize = target.getPixelSize();
+    double threshold = detailThreshold * pixelSize;
+    std::vector<Shape *> order;
+    order.reserve(count);
+    for (const auto & element : shapes) {
+        order.push_back(asShape(element));
+    }
+    std::vector<bool> hidden;
+    if (occlusionCulling) {
+        hidden.assign(order.size(), false);
+        CoverageMask mask(target.getViewport(), pixelSize);
+        int culled = 0;
+        for (int i = (int) order.size() - 1; i >= 0; i--) {
+            GRectangle bounds = order[i]->getBounds();
+            if (mask.covers(bounds)) {
+                hidden[i] = true;
+                culled++;
+            } else if (isOccluder(order[i])
+                       && !isBelowDetail(order[i], bounds, threshold)) {
+                mask.cover(bounds);
+            }
+        }
+        INSTRUMENT_COUNT(PROBE_OCCLUSION_CULLED, 1, culled, 0);
+    }
+    DetailPixels reduced(pixelSize);
+    GRectangle viewport = target.getViewport();
+    for (int i = 0; i < (int) order.size(); i++) {
+        if (occlusionCulling && hidden[i]) continue;
+        drawShape(order[i], target, reduced, threshold, viewport);
+    }
+    reduced.flush(target);
+}
+
+}
+
+void ShapeList::draw(RenderTarget & target) const {
+    drawShapes(*this, size(), target, detailThreshold, occlusionCulling);
+}
+
+void ShapeList::draw(GWindow & gw) const {
+    WindowTarget target(gw);
+    draw(target);
 }
 
 Shape* ShapeList::getShapeAt(double x, double y) const {
-    for (Shape *shape : *this) {
-        if (shape->contains(x, y)) {
-            return shape;
+    INSTRUMENT_SCOPE(PROBE_GET_SHAPE_AT);
+    double cellX = x;
+    double cellY = y;
+    if (hitQuantum > 0) {
+        cellX = std::floor(x / hitQuantum);
+        cellY = std::floor(y / hitQuantum);
+        x = (cellX + 0.5) * hitQuantum;
+        y = (cellY + 0.5) * hitQuantum;
+    } else {
+        cellX = std::floor(x);
+        cellY = std::floor(y);
+    }
+    unsigned long long hash = (unsigned long long) (long long) cellX * 73856093ULL
+                            ^ (unsigned long long) (long long) cellY * 19349663ULL;
+    HitEntry & entry = hitCache[hash % HIT_CACHE_SIZE];
+    // A pending update group has changed the scene without a new generation
+    if (!updateChanged && entry.generation == generation
+                       && entry.x == x && entry.y == y) {
+        hitCacheHits++;
+        return entry.shape;
+    }
+    hitCacheMisses++;
+    int visited = 0;
+    Shape *result = nullptr;
+    if (usePickIndex()) {
+        pickCandidates.clear();
+        pickIndex->queryPoint(x, y, pickCandidates);
+        std::sort(pickCandidates.begin(), pickCandidates.end(), std::greater<int>());
+        for (int i : pickCandidates) {
+            visited++;
+            if ((*this)[i]->contains(x, y)) {
+                result = (*this)[i];
+                break;
+            }
         }
+    } else {
+        for (int i = size() - 1; i >= 0; i--) {
+            visited++;
+            if ((*this)[i]->contains(x, y)) {
+                result = (*this)[i];
+                break;
+            }
+        }
+        scanVisited += visited;
+    }
+    INSTRUMENT_ITEMS(visited);
+    INSTRUMENT_COUNT(PROBE_SHAPE_CONTAINS, visited, 0, 0);
+    if (!updateChanged) entry = { x, y, generation, result };
+    return result;
+}
+
+bool ShapeList::usePickIndex() const {
+    // A pending update group has changed the scene without a new generation
+    if (updateChanged || size() < PICK_INDEX_MIN) return false;
+    if (pickIndex != nullptr && pickIndex->getGeneration() == generation) {
+        return true;
+    }
+    if (scanGeneration != generation) {
+        scanGeneration = generation;
+        scanVisited = 0;
+    }
+    if (scanVisited < (uint64_t) PICK_INDEX_FACTOR * size()) return false;
+    if (pickIndex == nullptr) pickIndex.reset(new ShapeIndex());
+    pickIndex->build(*this);
+    return true;
+}
+
+void ShapeList::setDetailThreshold(double pixels) {
+    detailThreshold = pixels;
+}
+
+double ShapeList::getDetailThreshold() const {
+    return detailThreshold;
+}
+
+void ShapeList::setOcclusionCulling(bool flag) {
+    occlusionCulling = flag;
+}
+
+bool ShapeList::isOcclusionCulling() const {
+    return occlusionCulling;
+}
+
+void ShapeList::setHitQuantum(double pixels) {
+    hitQuantum = pixels;
+    // Answers snapped to the old grid are dropped; the scene is unchanged
+    for (HitEntry & entry : hitCache) {
+        entry = { 0, 0, 0, nullptr };
+    }
+}
+
+double ShapeList::getHitQuantum() const {
+    return hitQuantum;
+}
+
+uint64_t ShapeList::getHitCacheHits() const {
+    return hitCacheHits;
+}
+
+uint64_t ShapeList::getHitCacheMisses() const {
+    return hitCacheMisses;
+}
+
+void ShapeList::resetHitCacheStats() {
+    hitCacheHits = hitCacheMisses = 0;
+}
+
+size_t ShapeList::getMemoryUsage() const {
+    size_t bytes = Vector<Shape *>::getMemoryUsage()
+                 - sizeof(Vector<Shape *>) + sizeof(ShapeList);
+    for (Shape *sp : *this) {
+        bytes += sp->getMemoryUsage();
+    }
+    // Each copy also has a shared_ptr slot and a control block
+    for (const std::shared_ptr<Shape> & copy : frozen) {
+        bytes += 2 * sizeof(std::shared_ptr<Shape>);
+        if (copy) bytes += copy->getMemoryUsage();
+    }
+    bytes += stale.size() * (sizeof(Shape *) + 2 * sizeof(void *))
+           + stale.bucket_count() * sizeof(void *);
+    bytes += positions.size() * (sizeof(Shape *) + sizeof(int) + 2 * sizeof(void *))
+           + positions.bucket_count() * sizeof(void *);
+    return bytes;
+}
+
+SceneSnapshot::SceneSnapshot() {
+    detailThreshold = 1;
+    occlusionCulling = true;
+    generation = 0;
+}
+
+int SceneSnapshot::size() const {
+    return shapes.size();
+}
+
+const Shape *SceneSnapshot::get(int index) const {
+    return shapes.get(index).get();
+}
+
+void SceneSnapshot::draw(RenderTarget & target) const {
+    drawShapes(shapes, shapes.size(), target, detailThreshold,
+               occlusionCulling);
+}
+
+void SceneSnapshot::draw(GWindow & gw) const {
+    WindowTarget target(gw);
+    draw(target);
+}
+
+const Shape *SceneSnapshot::getShapeAt(double x, double y) const {
+    for (int i = shapes.size() - 1; i >= 0; i--) {
+        const Shape *shape = shapes.get(i).get();
+        if (shape->contains(x, y)) return shape;
     }
     return nullptr;
-}
\ No newline at end of file
+}
+
+uint64_t SceneSnapshot::getGeneration() const {
+    return generation;
+}
@@ -8,15 +8,123 @@
 #define _shapelist_h
 #include "gwindow.h"
 #include "shape.h"
+#include "pvector.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+class ShapeIndex;
+/*
+* Class: ShapeListListener
+* ------------------------
+* Receives every change to a ShapeList after it is made: insertions and
+* removals with the index they affected, reorders as the old and new
+* index of the moved shape, and changes made to the shapes themselves.
+*/
+class ShapeListListener {
+public:
+virtual ~ShapeListListener() {}
+virtual void shapeInserted(int index, Shape *sp) = 0;
+virtual void shapeRemoved(int index, Shape *sp) = 0;
+virtual void shapeReordered(int from, int to) = 0;
+virtual void shapeUpdated(Shape *sp) = 0;
+virtual void shapesCleared() = 0;
+};
+/*
+* Class: SceneSnapshot
+* --------------------
+* An immutable copy of the shapes in a ShapeList, made by its snapshot
+* method. Copying a snapshot takes constant time, and successive
+* snapshots of a list share the copies of every shape that did not change
+* in between. A snapshot can be drawn on another thread while the list
+* goes on changing, and several threads may draw one snapshot at once;
+* hit tests on a shared snapshot must be serialized.
+*/
+class SceneSnapshot {
+public:
+SceneSnapshot();
+int size() const;
+const Shape *get(int index) const;
+/*
+* Methods: draw, getShapeAt
+* Usage: snapshot.draw(target);
+* Shape *sp = snapshot.getShapeAt(x, y);
+* --------------------------------------
+* Behave like the ShapeList methods as of the time of the snapshot, with
+* the detail threshold and culling setting the list had then. Hit tests
+* scan the shapes from the front.
+*/
+void draw(RenderTarget & target) const;
+void draw(GWindow & gw) const;
+const Shape *getShapeAt(double x, double y) const;
+/*
+* Method: getGeneration
+* Usage: if (snapshot.getGeneration() != shapes.getGeneration()) ...
+* ------------------------------------------------------------------
+* Returns the generation of the list the snapshot was taken from.
+*/
+uint64_t getGeneration() const;
+private:
+friend class ShapeList;
+PVector<std::shared_ptr<Shape> > shapes;
+double detailThreshold;
+bool occlusionCulling;
+uint64_t generation;
+};
 /*
 * Class: ShapeList
 * ----------------
 * This class is a vector of shapes arrached from back to front. The
 * individual elements of the ShapeList are pointers to Shape objects.
+* The list observes the shapes it holds and keeps a generation counter
+* that advances whenever the scene changes, so the methods that modify
+* the list are redeclared here to keep that counter current. Elements
+* must be replaced with set rather than by assigning through [] or an
+* iterator.
 */
-class ShapeList : public Vector<Shape *> {
+class ShapeList : public Vector<Shape *>, public ShapeObserver {
 public:
 /*
+* Constructor: ShapeList
+* Usage: ShapeList shapes;
+* ------------------------
+* Creates an empty ShapeList with the default level-of-detail threshold
+* of one pixel.
+*/
+ShapeList();
+~ShapeList();
+ShapeList(const ShapeList &) = delete;
+ShapeList & operator=(const ShapeList &) = delete;
+/*
+* Methods: add, push_back, insert, set, remove, clear
+* Usage: shapes.add(sp);
+* shapes.insert(index, sp);
+* shapes.set(index, sp);
+* shapes.remove(index);
+* ------------------------------------------------
+* Modify the list as the Vector methods do, and also attach the list as
+* the observer of added shapes and detach it from removed ones. Adding a
+* shape that is observed by another container signals an error.
+*/
+void add(Shape *sp);
+void push_back(Shape *sp);
+void insert(int index, Shape *sp);
+void set(int index, Shape *sp);
+void remove(int index);
+void clear();
+Shape *operator[](int index) const;
+/*
+* Method: addAll
+* Usage: shapes.addAll(array, count);
+* -----------------------------------
+* Adds count shapes to the front of the list in the order given, as one
+* update group, allocating room for all of them at once. If any of them
+* is observed by another container, the method signals an error before
+* adding any.
+*/
+void addAll(Shape *const *array, int count);
+/*
 * Methods: moveToFront, moveToBack, moveForward, moveBackward
 * Usage: shapes.moveToFront(sp);
 * shapes.moveToBack(sp);
@@ -33,13 +141,223 @@ void moveToBack(Shape *sp);
 void moveForward(Shape *sp);
 void moveBackward(Shape *sp);
 /*
+* Method: moveTo
+* Usage: shapes.moveTo(sp, index);
+* --------------------------------
+* Moves sp to the given position, shifting the shapes in between by one.
+* The method signals an error if sp is not in the ShapeList or index is
+* out of range.
+*/
+void moveTo(Shape *sp, int index);
+/*
+* Methods: beginUpdate, endUpdate
+* Usage: shapes.beginUpdate();
+* ... changes ...
+* shapes.endUpdate();
+* -------------------
+* Group a series of changes so that the generation advances once, when
+* the outermost endUpdate is called, instead of once per change. The
+* listener is still told about each change as it is made. Calls nest, and
+* a snapshot should not be taken until the outermost group has ended.
+*/
+void beginUpdate();
+void endUpdate();
+/*
 * Method: draw
-* Usage: shapes.draw(gw);
+* Usage: shapes.draw(target);
+* shapes.draw(gw);
 * -------------------------
-* Draws the shapes in the ShapeList on the graphics window. The shapes
-* are drawn from back to front, so that shapes closer to the front seem
-* to cover those further back.
+* Draws the shapes in the ShapeList on a render target, such as a
+* Framebuffer, or on the graphics window. The shapes are drawn from back
+* to front, so that shapes closer to the front seem to cover those further
+* back. Culling and the detail threshold work within the viewport of the
+* target.
 */
+void draw(RenderTarget & target) const;
 void draw(GWindow & gw) const;
+/*
+* Method: getShapeAt
+* Usage: Shape *sp = shapes.getShapeAt(x, y);
+* -------------------------------------------
+* Returns a pointer to the frontmost shape containing the point (x, y),
+* which is the one draw shows on top there, or nullptr if no shape in the
+* ShapeList contains it.
+*/
+Shape *getShapeAt(double x, double y) const;
+/*
+* Methods: setDetailThreshold, getDetailThreshold
+* Usage: shapes.setDetailThreshold(pixels);
+* double pixels = shapes.getDetailThreshold();
+* --------------------------------------------
+* Sets the screen size, in pixels of the target drawn on, below which draw
+* stops rendering shapes in full. A filled shape whose bounds are smaller than the threshold in
+* both dimensions is reduced to a single pixel, and all such shapes that
+* land on the same pixel between two full-size shapes are plotted once in
+* the color of the frontmost one. Lines shorter than the threshold in both
+* dimensions are skipped. A threshold of 0 disables the reduction.
+*/
+void setDetailThreshold(double pixels);
+double getDetailThreshold() const;
+/*
+* Methods: setOcclusionCulling, isOcclusionCulling
+* Usage: shapes.setOcclusionCulling(false);
+* -----------------------------------------
+* Turns occlusion culling on or off; it is on by default. With culling
+* on, draw first looks from front to back for filled rectangles and
+* squares, and skips every shape they hide completely within the viewport.
+* The result is the same picture with fewer shapes painted.
+*/
+void setOcclusionCulling(bool flag);
+bool isOcclusionCulling() const;
+/*
+* Method: getGeneration
+* Usage: uint64_t generation = shapes.getGeneration();
+* ----------------------------------------------------
+* Returns a counter that advances whenever a shape is added, removed or
+* reordered, or a shape in the list moves or changes color. Two equal
+* generations denote the same scene.
+*/
+uint64_t getGeneration() const;
+/*
+* Methods: setHitQuantum, getHitQuantum
+* Usage: shapes.setHitQuantum(pixels);
+* double pixels = shapes.getHitQuantum();
+* ---------------------------------------
+* getShapeAt remembers its recent answers until the generation changes.
+* With a quantum of 0, the default, an answer is reused only for exactly
+* the same point. With a positive quantum, getShapeAt snaps each query to
+* the center of its quantum-sized grid cell, so every point in a cell
+* shares one answer.
+*/
+void setHitQuantum(double pixels);
+double getHitQuantum() const;
+/*
+* Methods: getHitCacheHits, getHitCacheMisses, resetHitCacheStats
+* Usage: double rate = shapes.getHitCacheHits() /
+* double(shapes.getHitCacheHits() + shapes.getHitCacheMisses());
+* --------------------------------------------------------------
+* Report how many calls to getShapeAt were answered from the cache and
+* how many had to test the shapes.
+*/
+uint64_t getHitCacheHits() const;
+uint64_t getHitCacheMisses() const;
+void resetHitCacheStats();
+/*
+* Method: getMemoryUsage
+* Usage: size_t bytes = shapes.getMemoryUsage();
+* ----------------------------------------------
+* Returns the bytes used by the list and the shapes in it, including the
+* whole capacity of the list and the color strings of the shapes. Once a
+* snapshot has been taken, the copies the list keeps for snapshots are
+* counted too, although snapshots may share them.
+*/
+size_t getMemoryUsage() const;
+/*
+* Method: snapshot
+* Usage: SceneSnapshot frozen = shapes.snapshot();
+* ------------------------------------------------
+* Returns an immutable copy of the scene for rendering, undo or
+* replication. The first snapshot clones every shape; after that the
+* list keeps its copies up to date as it changes, and a snapshot clones
+* only the shapes that changed since the last one. Taking a snapshot of
+* an unchanged list takes constant time, and one after shapes have only
+* been changed, added at the end or replaced takes time proportional to
+* the number of changes. The first snapshot after an insertion, removal
+* or reorder elsewhere in the list also reindexes the whole list.
+*/
+SceneSnapshot snapshot() const;
+/*
+* Methods: setListener, getListener
+* Usage: shapes.setListener(listener);
+* ------------------------------------
+* Sets the listener that is told about every change to the list, or
+* removes it if listener is nullptr. A list has at most one listener.
+*/
+void setListener(ShapeListListener *listener);
+ShapeListListener *getListener() const;
+/*
+* Method: shapeChanged
+* Usage: (called by the shapes in the list)
+* -----------------------------------------
+* Advances the generation and tells the listener when an observed shape
+* changes.
+*/
+virtual void shapeChanged(Shape *sp);
+private:
+// Appending through these would bypass the observer bookkeeping
+using Vector<Shape *>::operator+=;
+using Vector<Shape *>::operator,;
+/*
+* Implementation notes: hit cache
+* -------------------------------
+* The cache is direct-mapped: a query hashes its grid cell to one slot,
+* and the slot is reused if it holds the same point from the current
+* generation. Bumping the generation therefore invalidates every entry
+* without touching them. Since the cache is updated by the const method
+* getShapeAt, concurrent queries on one list must be serialized.
+*/
+struct HitEntry {
+double x, y;
+uint64_t generation;
+Shape *shape;
+};
+static const int HIT_CACHE_SIZE = 64;
+/*
+* Implementation notes: pick index
+* --------------------------------
+* A cache miss scans the list from the front and stops at the first hit,
+* which still costs O(n) for points near the back or over no shape. On a
+* list of at least PICK_INDEX_MIN shapes, once the scans made since the
+* last change have visited PICK_INDEX_FACTOR times as many shapes as the
+* list holds, getShapeAt bulk-loads a ShapeIndex of the bounds and uses it
+* until the generation changes: the shapes whose bounds contain the point
+* are tested from the front, so the first hit is still the topmost. A list
+* that changes between most queries, as while dragging, never pays for an
+* index it would not reuse. A build costs about as much as scans visiting
+* 30 times as many shapes as the list holds, so once the scans have spent
+* half that, an index is likely to be reused long enough to pay for
+* itself; bench_pick measures both costs.
+*/
+static const int PICK_INDEX_MIN = 256;
+static const int PICK_INDEX_FACTOR = 16;
+bool usePickIndex() const;
+void attach(Shape *sp);
+void detach(Shape *sp);
+void bump();
+void reordered(int from, int to);
+void freeze(int index, Shape *sp);
+double detailThreshold;
+bool occlusionCulling;
+uint64_t generation;
+double hitQuantum;
+mutable HitEntry hitCache[HIT_CACHE_SIZE];
+mutable uint64_t hitCacheHits;
+mutable uint64_t hitCacheMisses;
+mutable std::unique_ptr<ShapeIndex> pickIndex;
+mutable std::vector<int> pickCandidates;
+mutable uint64_t scanGeneration;    // Generation scanVisited counts for
+mutable uint64_t scanVisited;
+ShapeListListener *listener;
+int updateDepth;
+bool updateChanged;           // Set when a grouped change defers a bump
+/*
+* Implementation notes: snapshots
+* -------------------------------
+* Once the first snapshot has been taken, frozen holds a copy of every
+* shape at the same index as the shape itself, and every change to the
+* list is applied to it as well. Shapes that change, or are added, are
+* recorded in stale instead of being copied at once, so a shape dragged
+* across the screen is copied only once per snapshot. The snapshot finds
+* the slots of the stale shapes in positions, which maps every shape to
+* its indices. Appending and replacing shapes keep it current; other
+* changes to the order mark it invalid, and the next snapshot that needs
+* it rebuilds it.
+*/
+void forgetPosition(Shape *sp, int index);
+mutable PVector<std::shared_ptr<Shape> > frozen;
+mutable std::unordered_set<Shape *> stale;
+mutable std::unordered_multimap<Shape *, int> positions;
+mutable bool positionsValid;
+mutable bool freezing;
 };
 #endif
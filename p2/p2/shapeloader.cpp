@@ -0,0 +1,72 @@
+/*
+ * File: shapeloader.cpp
+ * ---------------------
+ * This file implements the loadShapes function.
+ */
+
+#include "shapeloader.h"
+#include "parallel.h"
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+Shape *createShape(const ShapeSpec & spec) {
+    Shape *sp;
+    switch (spec.type) {
+    case SHAPE_LINE:
+        sp = new Line(spec.x, spec.y, spec.x + spec.width, spec.y + spec.height);
+        break;
+    case SHAPE_SQUARE:
+        sp = new Square(spec.x, spec.y, spec.width);
+        break;
+    case SHAPE_RECT:
+        sp = new Rect(spec.x, spec.y, spec.width, spec.height);
+        break;
+    default:
+        sp = new Oval(spec.x, spec.y, spec.width, spec.height);
+        break;
+    }
+    if (!spec.color.empty()) sp->setColor(spec.color);
+    return sp;
+}
+
+}
+
+/*
+ * Implementation notes: loadShapes
+ * --------------------------------
+ * Each thread fills its own range of a preallocated array, so the threads
+ * share nothing but the input. The shapes have no observer while they are
+ * built, and the list takes them all in one update group afterward, so
+ * constructing them needs no locking. If construction fails, the shapes
+ * already made are deleted before the exception propagates.
+ */
+
+void loadShapes(ShapeList & shapes, const ShapeSpec *specs, int count,
+                ShapeIndex *index, int threadCount) {
+    for (int i = 0; i < count; i++) {
+        ShapeType type = specs[i].type;
+        if (type != SHAPE_LINE && type != SHAPE_SQUARE
+                               && type != SHAPE_RECT && type != SHAPE_OVAL) {
+            throw runtime_error("loadShapes: unsupported shape type");
+        }
+    }
+    vector<Shape *> created(count, nullptr);
+    try {
+        parallelFor(count, threadCount, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                created[i] = createShape(specs[i]);
+            }
+        });
+    } catch (...) {
+        for (Shape *sp : created) {
+            delete sp;
+        }
+        throw;
+    }
+    shapes.addAll(created.data(), count);
+    if (index != nullptr) index->build(shapes, threadCount);
+}
@@ -0,0 +1,38 @@
+/*
+* File: shapeloader.h
+* -------------------
+* This file defines loadShapes, which builds a large scene from an array
+* of shape descriptions using several threads.
+*/
+#ifndef _shapeloader_h
+#define _shapeloader_h
+#include <string>
+#include "shapeindex.h"
+#include "shapelist.h"
+/*
+* Type: ShapeSpec
+* ---------------
+* Describes a line, square, rectangle or oval. For a line, (x, y) is the
+* start and (width, height) the offset to the end; a square uses width as
+* its size. An empty color leaves the shape black.
+*/
+struct ShapeSpec {
+ShapeType type;
+double x, y, width, height;
+std::string color;
+};
+/*
+* Function: loadShapes
+* Usage: loadShapes(shapes, specs, count);
+* loadShapes(shapes, specs, count, &index, threadCount);
+* ------------------------------------------------------
+* Creates a shape for each of the count specs, constructing them on up to
+* threadCount threads, or as many as the hardware runs at once if
+* threadCount is 0, and adds them to the front of shapes in order with
+* addAll. If index is not nullptr, it is then rebuilt over the whole list
+* by bulk loading. The function signals an error, adding nothing, if a
+* spec has a type other than those listed above.
+*/
+void loadShapes(ShapeList & shapes, const ShapeSpec *specs, int count,
+ShapeIndex *index = nullptr, int threadCount = 0);
+#endif
@@ -0,0 +1,150 @@
+/*
+ * File: shapequeue.cpp
+ * --------------------
+ * This file implements the ShapeCommandQueue class.
+ */
+
+#include "shapequeue.h"
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace std;
+
+static_assert(is_trivially_copyable<ShapeCommand>::value,
+              "Commands are copied into the ring without allocating");
+
+ShapeCommandQueue::ShapeCommandQueue(int capacity) {
+    if (capacity < 2) {
+        throw runtime_error("ShapeCommandQueue: capacity must be at least 2");
+    }
+    size_t size = 2;
+    while (size < (size_t) capacity) {
+        size *= 2;
+    }
+    cells.reset(new Cell[size]);
+    for (size_t i = 0; i < size; i++) {
+        cells[i].sequence.store(i, memory_order_relaxed);
+    }
+    mask = size - 1;
+    enqueuePos.store(0, memory_order_relaxed);
+    dequeuePos = 0;
+}
+
+ShapeCommandQueue::~ShapeCommandQueue() {
+    ShapeCommand command;
+    while (take(command)) {
+        if (command.type == CMD_ADD) delete command.shape;
+    }
+}
+
+bool ShapeCommandQueue::post(const ShapeCommand & command) {
+    if (command.type == CMD_SET_COLOR && !command.color.isValid()) {
+        throw runtime_error("ShapeCommandQueue::post: Undefined color");
+    }
+    size_t pos = enqueuePos.load(memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        size_t sequence = cell->sequence.load(memory_order_acquire);
+        intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1,
+                                                 memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;    // The consumer has not emptied this cell yet
+        } else {
+            pos = enqueuePos.load(memory_order_relaxed);
+        }
+    }
+    cell->command = command;
+    cell->sequence.store(pos + 1, memory_order_release);
+    return true;
+}
+
+bool ShapeCommandQueue::postAdd(Shape *sp) {
+    return post({ CMD_ADD, sp, 0, 0, ColorId() });
+}
+
+bool ShapeCommandQueue::postRemove(Shape *sp) {
+    return post({ CMD_REMOVE, sp, 0, 0, ColorId() });
+}
+
+bool ShapeCommandQueue::postMove(Shape *sp, double dx, double dy) {
+    return post({ CMD_MOVE, sp, dx, dy, ColorId() });
+}
+
+bool ShapeCommandQueue::postSetLocation(Shape *sp, double x, double y) {
+    return post({ CMD_SET_LOCATION, sp, x, y, ColorId() });
+}
+
+bool ShapeCommandQueue::postSetColor(Shape *sp, string_view color) {
+    return postSetColor(sp, resolveColor(color));
+}
+
+bool ShapeCommandQueue::postSetColor(Shape *sp, ColorId color) {
+    return post({ CMD_SET_COLOR, sp, 0, 0, color });
+}
+
+int ShapeCommandQueue::drain(ShapeList & shapes, int limit) {
+    int applied = 0;
+    ShapeCommand command;
+    shapes.beginUpdate();
+    try {
+        while (applied != limit && take(command)) {
+            apply(shapes, command);
+            applied++;
+        }
+    } catch (...) {
+        shapes.endUpdate();
+        throw;
+    }
+    shapes.endUpdate();
+    return applied;
+}
+
+int ShapeCommandQueue::getCapacity() const {
+    return (int) (mask + 1);
+}
+
+bool ShapeCommandQueue::take(ShapeCommand & command) {
+    Cell & cell = cells[dequeuePos & mask];
+    if (cell.sequence.load(memory_order_acquire) != dequeuePos + 1) {
+        return false;
+    }
+    command = cell.command;
+    cell.sequence.store(dequeuePos + mask + 1, memory_order_release);
+    dequeuePos++;
+    return true;
+}
+
+void ShapeCommandQueue::apply(ShapeList & shapes, ShapeCommand & command) {
+    Shape *sp = command.shape;
+    switch (command.type) {
+    case CMD_ADD:
+        shapes.add(sp);
+        break;
+    case CMD_REMOVE: {
+        // Recently added shapes are the likeliest to be removed
+        for (int i = shapes.size() - 1; i >= 0; i--) {
+            if (shapes[i] == sp) {
+                shapes.remove(i);
+                delete sp;
+                return;
+            }
+        }
+        throw runtime_error("Shape not found in ShapeList.");
+    }
+    case CMD_MOVE:
+        sp->move(command.x, command.y);
+        break;
+    case CMD_SET_LOCATION:
+        sp->setLocation(command.x, command.y);
+        break;
+    case CMD_SET_COLOR:
+        sp->setColor(command.color);
+        break;
+    }
+}
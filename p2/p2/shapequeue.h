@@ -0,0 +1,123 @@
+/*
+* File: shapequeue.h
+* ------------------
+* This file defines a ShapeCommandQueue class through which any number of
+* threads can send changes to a ShapeList owned by another thread.
+*/
+#ifndef _shapequeue_h
+#define _shapequeue_h
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include "colortable.h"
+#include "shapelist.h"
+/*
+* Type: ShapeCommandType
+* ----------------------
+* The changes a ShapeCommand can make to a ShapeList.
+*/
+enum ShapeCommandType {
+CMD_ADD, CMD_REMOVE, CMD_MOVE, CMD_SET_LOCATION, CMD_SET_COLOR
+};
+/*
+* Type: ShapeCommand
+* ------------------
+* One change to a ShapeList. The fields x and y hold the offset of a move
+* or the new location, and color the new color, resolved by the producer;
+* fields a command does not use are ignored. A command holds no string,
+* so posting and draining one copies a few words and never allocates.
+*/
+struct ShapeCommand {
+ShapeCommandType type;
+Shape *shape;
+double x, y;
+ColorId color;
+};
+/*
+* Class: ShapeCommandQueue
+* ------------------------
+* A bounded queue of shape commands with many producers and one consumer.
+* Producers post commands without taking a lock, and the thread that owns
+* the ShapeList applies them in batches by calling drain, typically once
+* before each draw.
+*
+* A producer must not touch a shape after posting the command that adds
+* it: the shape belongs to the list from then on, and later commands only
+* name it. Applying a remove command deletes the shape, so it must be the
+* last command to name it.
+*/
+class ShapeCommandQueue {
+public:
+/*
+* Constructor: ShapeCommandQueue
+* Usage: ShapeCommandQueue queue(capacity);
+* -----------------------------------------
+* Creates an empty queue holding at least capacity commands. The capacity
+* is rounded up to a power of two.
+*/
+explicit ShapeCommandQueue(int capacity = 4096);
+~ShapeCommandQueue();
+ShapeCommandQueue(const ShapeCommandQueue &) = delete;
+ShapeCommandQueue & operator=(const ShapeCommandQueue &) = delete;
+/*
+* Method: post
+* Usage: if (!queue.post(command)) ...
+* ------------------------------------
+* Appends a command to the queue and returns true, or returns false at
+* once if the queue is full. Any thread may call post. A color command
+* whose color is not valid signals an error.
+*/
+bool post(const ShapeCommand & command);
+/*
+* Methods: postAdd, postRemove, postMove, postSetLocation, postSetColor
+* Usage: queue.postMove(sp, dx, dy);
+* ----------------------------------
+* Post the command that calls the ShapeList or Shape method of the same
+* name on sp. postSetColor resolves a color name before posting, and
+* signals an error if it is not a color.
+*/
+bool postAdd(Shape *sp);
+bool postRemove(Shape *sp);
+bool postMove(Shape *sp, double dx, double dy);
+bool postSetLocation(Shape *sp, double x, double y);
+bool postSetColor(Shape *sp, std::string_view color);
+bool postSetColor(Shape *sp, ColorId color);
+/*
+* Method: drain
+* Usage: int applied = queue.drain(shapes);
+* int applied = queue.drain(shapes, limit);
+* -----------------------------------------
+* Applies the queued commands to shapes in the order they were posted,
+* stopping after limit commands if a limit is given, and returns how many
+* were applied. The whole batch is one update group of the list, so its
+* generation advances once per batch. Only one thread may call drain.
+*/
+int drain(ShapeList & shapes, int limit = -1);
+int getCapacity() const;
+private:
+/*
+* Implementation notes: ShapeCommandQueue
+* ---------------------------------------
+* The queue is a ring of cells, each stamped with a sequence number that
+* says whose turn it is to use the cell. A cell whose sequence equals the
+* enqueue position is free for the producer that claims that position
+* with a compare-and-swap; once filled, its sequence becomes position + 1,
+* which hands it to the consumer; once emptied, its sequence advances by
+* the capacity, which hands it to the producer one lap later. The two
+* positions sit on separate cache lines so producers and the consumer do
+* not invalidate each other's line on every command.
+*/
+struct Cell {
+std::atomic<size_t> sequence;
+ShapeCommand command;
+};
+static const size_t CACHE_LINE = 64;
+bool take(ShapeCommand & command);
+void apply(ShapeList & shapes, ShapeCommand & command);
+std::unique_ptr<Cell[]> cells;
+size_t mask;
+alignas(CACHE_LINE) std::atomic<size_t> enqueuePos;
+alignas(CACHE_LINE) size_t dequeuePos;   // Touched only by drain
+};
+#endif
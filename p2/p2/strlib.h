@@ -8,8 +8,14 @@
 #ifndef _strlib_h
 #define _strlib_h
 
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <string_view>
 
 /*
  * Function: integerToString
@@ -27,10 +33,12 @@ std::string integerToString(int n);
  * ------------------------------------
  * Converts a string of digits into an integer.  If the string is not a
  * legal integer or contains extraneous characters other than whitespace,
- * stringToInteger calls error with an appropriate message.
+ * stringToInteger calls error with an appropriate message.  The digits
+ * are converted in place with std::from_chars, so a call allocates nothing
+ * unless it fails.
  */
 
-int stringToInteger(std::string str);
+int stringToInteger(std::string_view str);
 
 /*
  * Function: realToString
@@ -49,10 +57,11 @@ std::string realToString(double d);
  * Converts a string representing a real number into its corresponding
  * value.  If the string is not a legal floating-point number or contains
  * extraneous characters other than whitespace, stringToReal calls error
- * with an appropriate message.
+ * with an appropriate message.  Like stringToInteger, it converts the
+ * number in place without allocating.
  */
 
-double stringToReal(std::string str);
+double stringToReal(std::string_view str);
 
 /*
  * Function: toUpperCase
@@ -64,6 +73,15 @@ double stringToReal(std::string str);
 
 std::string toUpperCase(std::string str);
 
+/*
+ * Function: toUpperCaseInPlace
+ * Usage: toUpperCaseInPlace(str);
+ * -------------------------------
+ * Converts the lowercase characters of str to uppercase in place.
+ */
+
+void toUpperCaseInPlace(std::string & str);
+
 /*
  * Function: toLowerCase
  * Usage: string s = toLowerCase(str);
@@ -74,6 +92,15 @@ std::string toUpperCase(std::string str);
 
 std::string toLowerCase(std::string str);
 
+/*
+ * Function: toLowerCaseInPlace
+ * Usage: toLowerCaseInPlace(str);
+ * -------------------------------
+ * Converts the uppercase characters of str to lowercase in place.
+ */
+
+void toLowerCaseInPlace(std::string & str);
+
 /*
  * Function: equalsIgnoreCase
  * Usage: if (equalsIgnoreCase(s1, s2)) ...
@@ -81,7 +108,7 @@ std::string toLowerCase(std::string str);
  * Returns true if s1 and s2 are equal discounting differences in case.
  */
 
-bool equalsIgnoreCase(std::string s1, std::string s2);
+bool equalsIgnoreCase(std::string_view s1, std::string_view s2);
 
 /*
  * Function: startsWith
@@ -91,8 +118,8 @@ bool equalsIgnoreCase(std::string s1, std::string s2);
  * may be either a string or a character.
  */
 
-bool startsWith(std::string str, std::string prefix);
-bool startsWith(std::string str, char prefix);
+bool startsWith(std::string_view str, std::string_view prefix);
+bool startsWith(std::string_view str, char prefix);
 
 /*
  * Function: endsWith
@@ -102,8 +129,8 @@ bool startsWith(std::string str, char prefix);
  * be either a string or a character.
  */
 
-bool endsWith(std::string str, std::string suffix);
-bool endsWith(std::string str, char suffix);
+bool endsWith(std::string_view str, std::string_view suffix);
+bool endsWith(std::string_view str, char suffix);
 
 /*
  * Function: trim
@@ -115,6 +142,26 @@ bool endsWith(std::string str, char suffix);
 
 std::string trim(std::string str);
 
+/*
+ * Function: trimInPlace
+ * Usage: trimInPlace(str);
+ * ------------------------
+ * Removes any whitespace characters from the beginning and end of str.
+ */
+
+void trimInPlace(std::string & str);
+
+/*
+ * Function: trimView
+ * Usage: string_view trimmed = trimView(str);
+ * -------------------------------------------
+ * Returns the part of str left after removing any whitespace characters
+ * from its beginning and end, without copying it.  The result refers to
+ * the characters of str, so it is valid only as long as they are.
+ */
+
+std::string_view trimView(std::string_view str);
+
 /* Private section */
 
 /**********************************************************************/
@@ -168,7 +215,7 @@ bool stringNeedsQuoting(const std::string & str);
 
 template <typename ValueType>
 void writeGenericValue(std::ostream & os, const ValueType & value,
-                       bool forceQuotes) {
+                       bool /* forceQuotes */) {
    os << value;
 }
 
@@ -197,4 +244,144 @@ inline void readGenericValue(std::istream & is, std::string & value) {
 }
 
 
+/*
+ * Implementation notes: string_view functions
+ * -------------------------------------------
+ * The functions that only examine their arguments take std::string_view,
+ * so strings, string literals and views all pass without being copied and
+ * no call is ambiguous between overloads.  They are defined here so that
+ * they can be inlined into the loops of parsers.  Characters are
+ * classified as unsigned char, as <cctype> requires.
+ */
+
+namespace strlib {
+
+inline bool isSpace(char ch) {
+   return std::isspace((unsigned char) ch) != 0;
+}
+
+inline char toLower(char ch) {
+   return (char) std::tolower((unsigned char) ch);
+}
+
+inline char toUpper(char ch) {
+   return (char) std::toupper((unsigned char) ch);
+}
+
+/*
+ * Returns the number in str without surrounding whitespace or a leading
+ * plus sign, which std::from_chars does not accept, or an empty view if
+ * nothing would be left.
+ */
+inline std::string_view numberText(std::string_view str) {
+   std::string_view text = trimView(str);
+   if (text.size() > 1 && text[0] == '+' && text[1] != '-' && text[1] != '+') {
+      text.remove_prefix(1);
+   }
+   return text;
+}
+
+}
+
+inline int stringToInteger(std::string_view str) {
+   extern void error(std::string msg);
+   std::string_view text = strlib::numberText(str);
+   const char *end = text.data() + text.size();
+   int value = 0;
+   std::from_chars_result result = std::from_chars(text.data(), end, value);
+   if (text.empty() || result.ec != std::errc() || result.ptr != end) {
+      error("stringToInteger: Illegal integer format (" + std::string(str) + ")");
+   }
+   return value;
+}
+
+/*
+ * Where the library lacks the floating-point overloads of from_chars,
+ * which __cpp_lib_to_chars reports, stringToReal copies short numbers to
+ * the stack for strtod, which needs a terminated string.
+ */
+
+inline double stringToReal(std::string_view str) {
+   extern void error(std::string msg);
+   std::string_view text = strlib::numberText(str);
+   const char *end = text.data() + text.size();
+   double value = 0;
+   bool ok = !text.empty();
+#if defined(__cpp_lib_to_chars)
+   std::from_chars_result result = std::from_chars(text.data(), end, value);
+   ok = ok && result.ec == std::errc() && result.ptr == end;
+#else
+   char buffer[64];
+   ok = ok && text.size() < sizeof buffer;
+   if (ok) {
+      std::memcpy(buffer, text.data(), text.size());
+      buffer[text.size()] = '\0';
+      char *stop;
+      errno = 0;
+      value = std::strtod(buffer, &stop);
+      ok = stop == buffer + text.size() && errno != ERANGE;
+   }
+   (void) end;
+#endif
+   if (!ok) {
+      error("stringToReal: Illegal floating-point format (" + std::string(str) + ")");
+   }
+   return value;
+}
+
+inline void toUpperCaseInPlace(std::string & str) {
+   for (char & ch : str) {
+      ch = strlib::toUpper(ch);
+   }
+}
+
+inline void toLowerCaseInPlace(std::string & str) {
+   for (char & ch : str) {
+      ch = strlib::toLower(ch);
+   }
+}
+
+inline bool equalsIgnoreCase(std::string_view s1, std::string_view s2) {
+   if (s1.size() != s2.size()) return false;
+   for (size_t i = 0; i < s1.size(); i++) {
+      if (strlib::toLower(s1[i]) != strlib::toLower(s2[i])) return false;
+   }
+   return true;
+}
+
+inline bool startsWith(std::string_view str, std::string_view prefix) {
+   return str.size() >= prefix.size()
+       && str.compare(0, prefix.size(), prefix) == 0;
+}
+
+inline bool startsWith(std::string_view str, char prefix) {
+   return !str.empty() && str.front() == prefix;
+}
+
+inline bool endsWith(std::string_view str, std::string_view suffix) {
+   return str.size() >= suffix.size()
+       && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+inline bool endsWith(std::string_view str, char suffix) {
+   return !str.empty() && str.back() == suffix;
+}
+
+inline std::string_view trimView(std::string_view str) {
+   size_t start = 0;
+   size_t finish = str.size();
+   while (start < finish && strlib::isSpace(str[start])) start++;
+   while (finish > start && strlib::isSpace(str[finish - 1])) finish--;
+   return str.substr(start, finish - start);
+}
+
+inline void trimInPlace(std::string & str) {
+   size_t finish = str.size();
+   while (finish > 0 && strlib::isSpace(str[finish - 1])) finish--;
+   str.erase(finish);
+   size_t start = 0;
+   while (start < str.size() && strlib::isSpace(str[start])) start++;
+   str.erase(0, start);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,427 @@
+/*
+ * File: tilecache.cpp
+ * -------------------
+ * This file implements the TileCache class.
+ */
+
+#include "tilecache.h"
+#include "instrument.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace {
+
+/*
+ * Class: ScaledTarget
+ * -------------------
+ * Draws the scene into a tile, scaling scene coordinates to the pixels of
+ * its level and shifting the tile's top-left pixel to the origin.
+ */
+class ScaledTarget : public RenderTarget {
+public:
+    ScaledTarget(Framebuffer & fb, double scale, double left, double top)
+        : fb(fb) {
+        this->scale = scale;
+        this->left = left;
+        this->top = top;
+    }
+
+    virtual GRectangle getViewport() const {
+        return GRectangle(left / scale, top / scale,
+                          fb.getWidth() / scale, fb.getHeight() / scale);
+    }
+
+    virtual double getPixelSize() const {
+        return 1 / scale;
+    }
+
+    virtual void setColor(ColorId color) {
+        fb.setColor(color);
+    }
+
+    virtual void drawLine(double x0, double y0, double x1, double y1) {
+        fb.drawLine(toX(x0), toY(y0), toX(x1), toY(y1));
+    }
+
+    virtual void fillRect(double x, double y, double width, double height) {
+        fb.fillRect(toX(x), toY(y), width * scale, height * scale);
+    }
+
+    virtual void fillOval(double x, double y, double width, double height) {
+        fb.fillOval(toX(x), toY(y), width * scale, height * scale);
+    }
+
+    virtual void fillPolygon(const double *coords, int count, double x,
+                             double y, FillRule rule) {
+        scaled.resize(2 * (size_t) max(count, 0));
+        for (size_t k = 0; k < scaled.size(); k++) {
+            scaled[k] = coords[k] * scale;
+        }
+        fb.fillPolygon(scaled.data(), count, toX(x), toY(y), rule);
+    }
+
+private:
+    double toX(double x) const {
+        return x * scale - left;
+    }
+
+    double toY(double y) const {
+        return y * scale - top;
+    }
+
+    Framebuffer & fb;
+    double scale;
+    double left, top;
+    vector<double> scaled;
+};
+
+int64_t floorDiv(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+/*
+ * A run of consecutive view columns, or rows, whose level pixels fall in
+ * the same column, or row, of tiles.
+ */
+struct Span {
+    int begin, end;
+    int64_t tile;
+};
+
+vector<Span> splitIntoSpans(const vector<int64_t> & pixels) {
+    vector<Span> spans;
+    for (int i = 0; i < (int) pixels.size(); i++) {
+        int64_t tile = floorDiv(pixels[i], TileCache::TILE_SIZE);
+        if (spans.empty() || spans.back().tile != tile) {
+            spans.push_back({ i, i, tile });
+        }
+        spans.back().end = i + 1;
+    }
+    return spans;
+}
+
+bool overlaps(const GRectangle & a, const GRectangle & b) {
+    return a.getX() <= b.getX() + b.getWidth()
+        && b.getX() <= a.getX() + a.getWidth()
+        && a.getY() <= b.getY() + b.getHeight()
+        && b.getY() <= a.getY() + a.getHeight();
+}
+
+}
+
+const int TileCache::TILE_SIZE;
+const size_t TileCache::TILE_BYTES;
+
+bool TileCache::TileKey::operator==(const TileKey & other) const {
+    return level == other.level && column == other.column && row == other.row;
+}
+
+size_t TileCache::TileKeyHash::operator()(const TileKey & key) const {
+    size_t h = hash<int64_t>()(key.column);
+    h = h * 31 + hash<int64_t>()(key.row);
+    return h * 31 + (size_t) key.level;
+}
+
+TileCache::TileCache(ShapeList & shapes, int levelCount, size_t memoryBudget,
+                     int threadCount) : shapes(shapes) {
+    if (levelCount < 1) {
+        throw runtime_error("TileCache: There must be at least one level");
+    }
+    this->levelCount = levelCount;
+    maxTiles = max((size_t) 1, memoryBudget / TILE_BYTES);
+    scene = shapes.snapshot();
+    stats = TileStats { 0, 0, 0, 0, 0 };
+    stopping = false;
+    if (threadCount <= 0) threadCount = getDefaultThreadCount();
+    for (int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&TileCache::workerLoop, this);
+    }
+}
+
+TileCache::~TileCache() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    workReady.notify_all();
+    workDone.notify_all();
+    for (thread & worker : workers) {
+        worker.join();
+    }
+}
+
+int TileCache::getLevel(double scale) const {
+    if (!(scale > 0)) return levelCount - 1;
+    // The tolerance keeps scales that are exact powers of 2 on their level
+    int level = (int) floor(log2(1 / scale) + 1e-9);
+    return max(0, min(levelCount - 1, level));
+}
+
+int TileCache::getLevelCount() const {
+    return levelCount;
+}
+
+/*
+ * Implementation notes: draw
+ * --------------------------
+ * Each column of the view is mapped to the column of level pixels under
+ * its center, and each row likewise, so the tile and the pixel in it that
+ * supply any pixel of the view are found by table lookups. When the view
+ * is at the scale of the level, the columns of a tile are consecutive and
+ * each row of the tile is copied with memcpy. A coarser tile stands in
+ * for a missing one by dividing the level pixels by a power of 2.
+ */
+int TileCache::draw(Framebuffer & view, double scale) {
+    if (!(scale > 0)) throw runtime_error("TileCache::draw: Scale must be positive");
+    int width = view.getWidth();
+    int height = view.getHeight();
+    int level = getLevel(scale);
+    double ratio = ldexp(1.0, -level) / scale;
+    vector<int64_t> levelX(width), levelY(height);
+    for (int i = 0; i < width; i++) {
+        levelX[i] = (int64_t) floor((view.getOriginX() + i + 0.5) * ratio);
+    }
+    for (int j = 0; j < height; j++) {
+        levelY[j] = (int64_t) floor((view.getOriginY() + j + 0.5) * ratio);
+    }
+    vector<Span> columns = splitIntoSpans(levelX);
+    vector<Span> rows = splitIntoSpans(levelY);
+    uint32_t *pixels = view.getPixels();
+    vector<TileKey> missing;
+    vector<int> sourceX(width);
+    for (const Span & row : rows) {
+        for (const Span & column : columns) {
+            TileKey key = { level, column.tile, row.tile };
+            Tile tile = find(key);
+            int shift = 0;
+            while (!tile && level + shift + 1 < levelCount) {
+                shift++;
+                tile = find({ level + shift, column.tile >> shift,
+                              row.tile >> shift });
+            }
+            if (shift > 0 || !tile) missing.push_back(key);
+            if (!tile) {
+                for (int j = row.begin; j < row.end; j++) {
+                    fill(pixels + (size_t) j * width + column.begin,
+                         pixels + (size_t) j * width + column.end, 0xFFFFFF);
+                }
+                continue;
+            }
+            int64_t divisor = (int64_t) 1 << shift;
+            int64_t left = (column.tile >> shift) * TILE_SIZE;
+            int64_t top = (row.tile >> shift) * TILE_SIZE;
+            for (int i = column.begin; i < column.end; i++) {
+                sourceX[i] = (int) (floorDiv(levelX[i], divisor) - left);
+            }
+            int count = column.end - column.begin;
+            bool contiguous = sourceX[column.end - 1] - sourceX[column.begin]
+                           == count - 1;
+            const uint32_t *source = tile->getPixels();
+            for (int j = row.begin; j < row.end; j++) {
+                int y = (int) (floorDiv(levelY[j], divisor) - top);
+                const uint32_t *from = source + (size_t) y * TILE_SIZE;
+                uint32_t *to = pixels + (size_t) j * width;
+                if (contiguous) {
+                    memcpy(to + column.begin, from + sourceX[column.begin],
+                           count * sizeof(uint32_t));
+                } else {
+                    for (int i = column.begin; i < column.end; i++) {
+                        to[i] = from[sourceX[i]];
+                    }
+                }
+            }
+        }
+    }
+    request(missing);
+    int drawn = (int) (rows.size() * columns.size() - missing.size());
+    exception_ptr error;
+    {
+        lock_guard<mutex> guard(lock);
+        stats.tilesDrawn += drawn;
+        stats.tilesMissing += missing.size();
+        swap(error, failure);
+    }
+    if (error) rethrow_exception(error);
+    return (int) missing.size();
+}
+
+// Looks up a tile and marks it as the most recently drawn
+TileCache::Tile TileCache::find(const TileKey & key) {
+    lock_guard<mutex> guard(lock);
+    auto found = tiles.find(key);
+    if (found == tiles.end()) return nullptr;
+    recent.splice(recent.begin(), recent, found->second.recent);
+    return found->second.tile;
+}
+
+void TileCache::request(const vector<TileKey> & keys) {
+    {
+        lock_guard<mutex> guard(lock);
+        queue.clear();
+        for (const TileKey & key : keys) {
+            if (inFlight.count(key) == 0) queue.push_back(key);
+        }
+        if (queue.empty()) return;
+    }
+    workReady.notify_all();
+}
+
+// Adds a rendered tile to the cache; the caller must hold the lock
+void TileCache::store(const TileKey & key, Tile tile) {
+    stats.tilesRendered++;
+    auto found = tiles.find(key);
+    if (found != tiles.end()) {
+        found->second.tile = tile;
+        recent.splice(recent.begin(), recent, found->second.recent);
+        return;
+    }
+    recent.push_front(key);
+    tiles[key] = Entry { tile, recent.begin() };
+    while (tiles.size() > maxTiles) {
+        tiles.erase(recent.back());
+        recent.pop_back();
+        stats.tilesEvicted++;
+    }
+}
+
+void TileCache::invalidate(const GRectangle & region) {
+    invalidate(vector<GRectangle>(1, region));
+}
+
+void TileCache::invalidate(const vector<GRectangle> & regions) {
+    SceneSnapshot frozen = shapes.snapshot();
+    lock_guard<mutex> guard(lock);
+    swap(scene, frozen);
+    for (const GRectangle & region : regions) {
+        dropOverlapping(region);
+    }
+}
+
+void TileCache::invalidateAll() {
+    SceneSnapshot frozen = shapes.snapshot();
+    lock_guard<mutex> guard(lock);
+    swap(scene, frozen);
+    tiles.clear();
+    recent.clear();
+    for (auto & job : inFlight) {
+        job.second = true;
+    }
+}
+
+// Antialiased edges may reach one level pixel outside a shape's bounds
+void TileCache::dropOverlapping(const GRectangle & region) {
+    auto reaches = [this, &region](const TileKey & key) {
+        GRectangle bounds = getTileBounds(key);
+        double pixel = ldexp(1.0, key.level);
+        GRectangle widened(bounds.getX() - pixel, bounds.getY() - pixel,
+                           bounds.getWidth() + 2 * pixel,
+                           bounds.getHeight() + 2 * pixel);
+        return overlaps(widened, region);
+    };
+    for (auto it = recent.begin(); it != recent.end(); ) {
+        if (reaches(*it)) {
+            tiles.erase(*it);
+            it = recent.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto & job : inFlight) {
+        if (reaches(job.first)) job.second = true;
+    }
+}
+
+GRectangle TileCache::getTileBounds(const TileKey & key) const {
+    double size = ldexp((double) TILE_SIZE, key.level);
+    return GRectangle(key.column * size, key.row * size, size, size);
+}
+
+TileCache::Tile TileCache::renderTile(const TileKey & key,
+                                      const SceneSnapshot & scene) const {
+    INSTRUMENT_SCOPE(PROBE_TILE_RENDER);
+    shared_ptr<Framebuffer> tile = make_shared<Framebuffer>(TILE_SIZE, TILE_SIZE);
+    ScaledTarget target(*tile, ldexp(1.0, -key.level),
+                        (double) key.column * TILE_SIZE,
+                        (double) key.row * TILE_SIZE);
+    scene.draw(target);
+    return tile;
+}
+
+/*
+ * Implementation notes: workerLoop
+ * --------------------------------
+ * A worker copies the current snapshot, which takes constant time, and
+ * renders without the lock. The copy is released before the lock is taken
+ * again, since releasing the last copy of a snapshot may free the copies
+ * of many shapes. A tile found stale when it is done goes back on the
+ * queue to be rendered from the newer snapshot.
+ */
+void TileCache::workerLoop() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        workReady.wait(guard, [this] { return stopping || !queue.empty(); });
+        if (stopping) break;
+        TileKey key = queue.front();
+        queue.pop_front();
+        inFlight[key] = false;
+        SceneSnapshot frozen = scene;
+        guard.unlock();
+        Tile tile;
+        exception_ptr error;
+        try {
+            tile = renderTile(key, frozen);
+        } catch (...) {
+            error = current_exception();
+        }
+        frozen = SceneSnapshot();
+        guard.lock();
+        bool stale = inFlight[key];
+        inFlight.erase(key);
+        if (error) {
+            if (!failure) failure = error;
+        } else if (stale) {
+            stats.tilesDiscarded++;
+            if (std::find(queue.begin(), queue.end(), key) == queue.end()) {
+                queue.push_back(key);
+            }
+        } else {
+            store(key, tile);
+        }
+        if (queue.empty() && inFlight.empty()) workDone.notify_all();
+    }
+}
+
+void TileCache::waitUntilIdle() {
+    exception_ptr error;
+    {
+        unique_lock<mutex> guard(lock);
+        workDone.wait(guard, [this] {
+            return stopping || (queue.empty() && inFlight.empty());
+        });
+        swap(error, failure);
+    }
+    if (error) rethrow_exception(error);
+}
+
+int TileCache::getTileCount() const {
+    lock_guard<mutex> guard(lock);
+    return (int) tiles.size();
+}
+
+size_t TileCache::getMemoryUsage() const {
+    lock_guard<mutex> guard(lock);
+    return tiles.size() * TILE_BYTES;
+}
+
+TileStats TileCache::getStats() const {
+    lock_guard<mutex> guard(lock);
+    return stats;
+}
@@ -0,0 +1,183 @@
+/*
+* File: tilecache.h
+* -----------------
+* This file defines a TileCache class that keeps a ShapeList rasterized
+* as square tiles at several zoom levels, so that panning and zooming
+* copy pixels instead of redrawing the scene.
+*/
+#ifndef _tilecache_h
+#define _tilecache_h
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "framebuffer.h"
+#include "gtypes.h"
+#include "shapelist.h"
+/*
+* Type: TileStats
+* ---------------
+* The counters kept by a TileCache. A tile is drawn when draw copies it
+* into a view and missing when draw needs it before it has been rendered.
+* Discarded tiles were rendered from a scene that changed under them
+* before they were done, and evicted tiles were dropped to stay within the
+* memory budget.
+*/
+struct TileStats {
+uint64_t tilesDrawn;
+uint64_t tilesMissing;
+uint64_t tilesRendered;
+uint64_t tilesDiscarded;
+uint64_t tilesEvicted;
+};
+/*
+* Class: TileCache
+* ----------------
+* Renders a ShapeList into tiles of TILE_SIZE by TILE_SIZE pixels on a
+* pool of worker threads, at zoom levels 0, 1, 2, ... whose scales are 1,
+* 1/2, 1/4, and so on. The tiles are kept in a cache that drops the least
+* recently drawn ones once they exceed a memory budget. Tiles show the
+* scene as of the construction of the cache or the last call to
+* invalidate, which the thread that changes the list must make with the
+* bounds of every shape that changed, before and after the change.
+*/
+class TileCache {
+public:
+static const int TILE_SIZE = 256;
+/*
+* Constructor: TileCache
+* Usage: TileCache tiles(shapes);
+* TileCache tiles(shapes, levelCount, memoryBudget, threadCount);
+* ---------------------------------------------------------------
+* Creates a cache for the given list, which must outlive it, and starts
+* its worker threads. The defaults are 8 zoom levels, a budget of 64 MB,
+* enough for 256 tiles, and one worker per hardware thread. The budget
+* should hold the tiles of a few views, or tiles will be dropped before
+* they are drawn.
+*/
+TileCache(ShapeList & shapes, int levelCount = 8,
+size_t memoryBudget = 64 << 20, int threadCount = 0);
+/*
+* Destructor: ~TileCache
+* ----------------------
+* Stops the worker threads, abandoning any tiles not yet rendered.
+*/
+~TileCache();
+TileCache(const TileCache &) = delete;
+TileCache & operator=(const TileCache &) = delete;
+/*
+* Method: draw
+* Usage: int missing = tiles.draw(view, scale);
+* ---------------------------------------------
+* Fills view with the scene magnified by scale, which is 1 at full size
+* and 0.5 at half size. The origin of view gives the position of its
+* top-left pixel in the magnified scene, so at scale 1 the view shows the
+* same pixels as drawing the list into it would. The tiles are taken from
+* the level with the smallest scale that is not below scale, and resampled
+* if the scales differ. Tiles that have not been rendered are requested
+* from the workers, replacing any requests left from earlier views, and
+* shown meanwhile from a coarser level if one is cached, or as white.
+* Returns the number of tiles that were missing; drawing again once
+* waitUntilIdle returns fills them in. If a worker failed to render a
+* tile, draw rethrows the exception it raised.
+*/
+int draw(Framebuffer & view, double scale);
+/*
+* Methods: invalidate, invalidateAll
+* Usage: tiles.invalidate(shape->getBounds());
+* tiles.invalidate(animator.getDirtyRegions());
+* tiles.invalidateAll();
+* ----------------------
+* Take a new snapshot of the list and drop every tile, at every level,
+* that overlaps one of the given rectangles of the scene, or every tile.
+* Tiles being rendered from the old snapshot are discarded when they are
+* done and rendered again.
+*/
+void invalidate(const GRectangle & region);
+void invalidate(const std::vector<GRectangle> & regions);
+void invalidateAll();
+/*
+* Method: waitUntilIdle
+* Usage: tiles.waitUntilIdle();
+* -----------------------------
+* Waits until every requested tile has been rendered.
+*/
+void waitUntilIdle();
+/*
+* Method: getLevel
+* Usage: int level = tiles.getLevel(scale);
+* -----------------------------------------
+* Returns the zoom level draw uses at the given scale.
+*/
+int getLevel(double scale) const;
+int getLevelCount() const;
+/*
+* Methods: getTileCount, getMemoryUsage, getStats
+* Usage: size_t bytes = tiles.getMemoryUsage();
+* ---------------------------------------------
+* Report the tiles held in the cache, the bytes of pixels they use, and
+* the counters kept since the cache was created.
+*/
+int getTileCount() const;
+size_t getMemoryUsage() const;
+TileStats getStats() const;
+private:
+/*
+* Implementation notes: TileCache
+* -------------------------------
+* A tile is identified by its level and its column and row in the pixel
+* grid of that level. The cache maps each key to its tile and to its
+* place in recent, which lists the keys from the most to the least
+* recently drawn. Tiles are immutable once rendered and held by shared
+* pointers, so draw copies its tiles out of the cache under the lock and
+* reads their pixels without it, and eviction never frees a tile that is
+* being drawn. The workers render from a shared SceneSnapshot. Each tile
+* in flight has a flag that invalidate sets if the tile overlaps what
+* changed, which keeps a tile rendered from a stale snapshot out of the
+* cache.
+*/
+struct TileKey {
+int level;
+int64_t column, row;
+bool operator==(const TileKey & other) const;
+};
+struct TileKeyHash {
+size_t operator()(const TileKey & key) const;
+};
+typedef std::shared_ptr<const Framebuffer> Tile;
+struct Entry {
+Tile tile;
+std::list<TileKey>::iterator recent;
+};
+static const size_t TILE_BYTES = TILE_SIZE * TILE_SIZE * sizeof(uint32_t);
+Tile find(const TileKey & key);
+void request(const std::vector<TileKey> & keys);
+void store(const TileKey & key, Tile tile);
+void dropOverlapping(const GRectangle & region);
+GRectangle getTileBounds(const TileKey & key) const;
+Tile renderTile(const TileKey & key, const SceneSnapshot & scene) const;
+void workerLoop();
+ShapeList & shapes;
+int levelCount;
+size_t maxTiles;
+SceneSnapshot scene;
+std::unordered_map<TileKey, Entry, TileKeyHash> tiles;
+std::list<TileKey> recent;
+std::deque<TileKey> queue;
+std::unordered_map<TileKey, bool, TileKeyHash> inFlight;   // Value is stale
+TileStats stats;
+std::exception_ptr failure;
+bool stopping;
+mutable std::mutex lock;
+std::condition_variable workReady;
+std::condition_variable workDone;
+std::vector<std::thread> workers;
+};
+#endif
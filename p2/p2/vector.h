@@ -8,11 +8,15 @@
 #ifndef _vector_h
 #define _vector_h
 
+#include <algorithm>
+#include <cstddef>
 #include <iterator>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include "strlib.h"
+#include "instrument.h"
 #include <sstream>
 
 
@@ -23,9 +27,13 @@
  * supports traditional array selection using square brackets, but also
  * supports inserting and deleting elements.  It is similar in function to
  * the STL vector type, but is simpler both to use and to implement.
+ *
+ * The optional second parameter is a standard allocator through which the
+ * vector obtains its storage, which lets a vector draw from an arena, for
+ * example as Vector<int, std::pmr::polymorphic_allocator<int> >.
  */
 
-template <typename ValueType>
+template <typename ValueType, typename Allocator = std::allocator<ValueType> >
 class Vector {
 
 public:
@@ -42,7 +50,9 @@ public:
  */
 
    Vector();
-   explicit Vector(int n, ValueType value = ValueType());
+   explicit Vector(const Allocator & alloc);
+   explicit Vector(int n, ValueType value = ValueType(),
+                   const Allocator & alloc = Allocator());
 
 /*
  * Destructor: ~Vector
@@ -135,6 +145,36 @@ public:
    void add(ValueType value);
    void push_back(ValueType value);
 
+/*
+ * Method: ensureCapacity
+ * Usage: vec.ensureCapacity(n);
+ * -----------------------------
+ * Makes room for at least n elements, so that adding elements up to that
+ * number does not reallocate the array.
+ */
+
+   void ensureCapacity(int n);
+
+/*
+ * Method: getAllocator
+ * Usage: Allocator alloc = vec.getAllocator();
+ * --------------------------------------------
+ * Returns a copy of the allocator used by this vector.
+ */
+
+   Allocator getAllocator() const;
+
+/*
+ * Method: getMemoryUsage
+ * Usage: size_t bytes = vec.getMemoryUsage();
+ * -------------------------------------------
+ * Returns the number of bytes this vector occupies, counting the object
+ * itself and the whole capacity of its array, but not any memory that the
+ * elements themselves point to.
+ */
+
+   size_t getMemoryUsage() const;
+
 /*
  * Operator: []
  * Usage: vec[index]
@@ -223,20 +263,27 @@ private:
  * Implementation notes: Vector data structure
  * -------------------------------------------
  * The elements of the Vector are stored in a dynamic array of the
- * specified element type.  If the space in the array is ever exhausted,
- * the implementation doubles the array capacity.
+ * specified element type, obtained from the allocator.  Only the first
+ * count slots hold constructed elements; the rest are raw storage.  If
+ * the space in the array is ever exhausted, the implementation doubles
+ * the array capacity.
  */
 
+   typedef std::allocator_traits<Allocator> Traits;
+
 /* Instance variables */
 
    ValueType *elements;        /* A dynamic array of the elements   */
    int capacity;               /* The allocated size of the array   */
    int count;                  /* The number of elements in use     */
+   [[no_unique_address]] Allocator alloc;
 
 /* Private methods */
 
    void expandCapacity();
+   void reallocate(int newCapacity);
    void deepCopy(const Vector & src);
+   void release();
 
 /*
  * Hidden features
@@ -414,24 +461,36 @@ extern void error(std::string msg);
  * for the array.
  */
 
-template <typename ValueType>
-Vector<ValueType>::Vector() {
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator>::Vector() {
+   count = capacity = 0;
+   elements = NULL;
+}
+
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator>::Vector(const Allocator & alloc) : alloc(alloc) {
    count = capacity = 0;
    elements = NULL;
 }
 
-template <typename ValueType>
-Vector<ValueType>::Vector(int n, ValueType value) {
-   count = capacity = n;
-   elements = (n == 0) ? NULL : new ValueType[n];
-   for (int i = 0; i < n; i++) {
-      elements[i] = value;
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator>::Vector(int n, ValueType value,
+                                     const Allocator & alloc) : alloc(alloc) {
+   count = capacity = 0;
+   elements = NULL;
+   if (n > 0) {
+      elements = Traits::allocate(this->alloc, n);
+      capacity = n;
+      for (int i = 0; i < n; i++) {
+         Traits::construct(this->alloc, elements + i, value);
+         count++;
+      }
    }
 }
 
-template <typename ValueType>
-Vector<ValueType>::~Vector() {
-   if (elements != NULL) delete[] elements;
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator>::~Vector() {
+   release();
 }
 
 /*
@@ -441,31 +500,44 @@ Vector<ValueType>::~Vector() {
  * detailed documentation.
  */
 
-template <typename ValueType>
-int Vector<ValueType>::size() const {
+template <typename ValueType, typename Allocator>
+int Vector<ValueType, Allocator>::size() const {
    return count;
 }
 
-template <typename ValueType>
-bool Vector<ValueType>::isEmpty() const {
+template <typename ValueType, typename Allocator>
+bool Vector<ValueType, Allocator>::isEmpty() const {
    return count == 0;
 }
 
-template <typename ValueType>
-void Vector<ValueType>::clear() {
-   if (elements != NULL) delete[] elements;
-   count = capacity = 0;
-   elements = NULL;
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::ensureCapacity(int n) {
+   if (n > capacity) reallocate(n);
 }
 
-template <typename ValueType>
-const ValueType & Vector<ValueType>::get(int index) const {
+template <typename ValueType, typename Allocator>
+Allocator Vector<ValueType, Allocator>::getAllocator() const {
+   return alloc;
+}
+
+template <typename ValueType, typename Allocator>
+size_t Vector<ValueType, Allocator>::getMemoryUsage() const {
+   return sizeof(*this) + (size_t) capacity * sizeof(ValueType);
+}
+
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::clear() {
+   release();
+}
+
+template <typename ValueType, typename Allocator>
+const ValueType & Vector<ValueType, Allocator>::get(int index) const {
    if (index < 0 || index >= count) error("get: index out of range");
    return elements[index];
 }
 
-template <typename ValueType>
-void Vector<ValueType>::set(int index, const ValueType & value) {
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::set(int index, const ValueType & value) {
    if (index < 0 || index >= count) error("set: index out of range");
    elements[index] = value;
 }
@@ -477,35 +549,42 @@ void Vector<ValueType>::set(int index, const ValueType & value) {
  * for a new element or to close up the space left by a deleted one.
  */
 
-template <typename ValueType>
-void Vector<ValueType>::insert(int index, ValueType value) {
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::insert(int index, ValueType value) {
    if (count == capacity) expandCapacity();
    if (index < 0 || index > count) {
       error("insert: index out of range");
    }
-   for (int i = count; i > index; i--) {
-      elements[i] = elements[i - 1];
+   if (index == count) {
+      Traits::construct(alloc, elements + count, std::move(value));
+   } else {
+      Traits::construct(alloc, elements + count,
+                        std::move(elements[count - 1]));
+      for (int i = count - 1; i > index; i--) {
+         elements[i] = std::move(elements[i - 1]);
+      }
+      elements[index] = std::move(value);
    }
-   elements[index] = value;
    count++;
 }
 
-template <typename ValueType>
-void Vector<ValueType>::remove(int index) {
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::remove(int index) {
    if (index < 0 || index >= count) error("remove: index out of range");
    for (int i = index; i < count - 1; i++) {
-      elements[i] = elements[i + 1];
+      elements[i] = std::move(elements[i + 1]);
    }
    count--;
+   Traits::destroy(alloc, elements + count);
 }
 
-template <typename ValueType>
-void Vector<ValueType>::add(ValueType value) {
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::add(ValueType value) {
    insert(count, value);
 }
 
-template <typename ValueType>
-void Vector<ValueType>::push_back(ValueType value) {
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::push_back(ValueType value) {
    insert(count, value);
 }
 
@@ -516,42 +595,42 @@ void Vector<ValueType>::push_back(ValueType value) {
  * brackets for the index.
  */
 
-template <typename ValueType>
-ValueType & Vector<ValueType>::operator[](int index) {
+template <typename ValueType, typename Allocator>
+ValueType & Vector<ValueType, Allocator>::operator[](int index) {
    if (index < 0 || index >= count) error("Selection index out of range");
    return elements[index];
 }
-template <typename ValueType>
-const ValueType & Vector<ValueType>::operator[](int index) const {
+template <typename ValueType, typename Allocator>
+const ValueType & Vector<ValueType, Allocator>::operator[](int index) const {
    if (index < 0 || index >= count) error("Selection index out of range");
    return elements[index];
 }
 
-template <typename ValueType>
-Vector<ValueType> Vector<ValueType>::operator+(const Vector & v2) const {
-   Vector<ValueType> vec = *this;
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator> Vector<ValueType, Allocator>::operator+(const Vector & v2) const {
+   Vector<ValueType, Allocator> vec = *this;
     for (int i = 0; i < v2.count; i++) {
         vec.add(v2.elements[i]);
     }
    return vec;
 }
 
-template <typename ValueType>
-Vector<ValueType> & Vector<ValueType>::operator+=(const Vector & v2) {
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator> & Vector<ValueType, Allocator>::operator+=(const Vector & v2) {
     for (int i = 0; i < v2.count; i++) {
         add(v2.elements[i]);
     }
    return *this;
 }
 
-template <typename ValueType>
-Vector<ValueType> & Vector<ValueType>::operator+=(const ValueType & value) {
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator> & Vector<ValueType, Allocator>::operator+=(const ValueType & value) {
    this->add(value);
    return *this;
 }
 
-template <typename ValueType>
-std::string Vector<ValueType>::toString() {
+template <typename ValueType, typename Allocator>
+std::string Vector<ValueType, Allocator>::toString() {
     std::ostringstream os;
    os << *this;
    return os.str();
@@ -564,26 +643,36 @@ std::string Vector<ValueType>::toString() {
  * described in the associated textbook.
  */
 
-template <typename ValueType>
-Vector<ValueType>::Vector(const Vector & src) {
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator>::Vector(const Vector & src)
+   : alloc(Traits::select_on_container_copy_construction(src.alloc)) {
+   count = capacity = 0;
+   elements = NULL;
    deepCopy(src);
 }
 
-template <typename ValueType>
-Vector<ValueType> & Vector<ValueType>::operator=(const Vector & src) {
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator> &
+Vector<ValueType, Allocator>::operator=(const Vector & src) {
    if (this != &src) {
-      if (elements != NULL) delete[] elements;
+      release();
+      if constexpr (Traits::propagate_on_container_copy_assignment::value) {
+         alloc = src.alloc;
+      }
       deepCopy(src);
    }
    return *this;
 }
 
-template <typename ValueType>
-void Vector<ValueType>::deepCopy(const Vector & src) {
-   count = capacity = src.count;
-   elements = (capacity == 0) ? NULL : new ValueType[capacity];
-   for (int i = 0; i < count; i++) {
-      elements[i] = src.elements[i];
+/* Must be called on an empty vector */
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::deepCopy(const Vector & src) {
+   if (src.count == 0) return;
+   elements = Traits::allocate(alloc, src.count);
+   capacity = src.count;
+   for (int i = 0; i < src.count; i++) {
+      Traits::construct(alloc, elements + i, src.elements[i]);
+      count++;
    }
 }
 
@@ -595,8 +684,8 @@ void Vector<ValueType>::deepCopy(const Vector & src) {
  * in the chain.
  */
 
-template <typename ValueType>
-Vector<ValueType> & Vector<ValueType>::operator,(const ValueType & value) {
+template <typename ValueType, typename Allocator>
+Vector<ValueType, Allocator> & Vector<ValueType, Allocator>::operator,(const ValueType & value) {
    this->add(value);
    return *this;
 }
@@ -608,23 +697,23 @@ Vector<ValueType> & Vector<ValueType>::operator,(const ValueType & value) {
  * function object to each element in ascending index order.
  */
 
-template <typename ValueType>
-void Vector<ValueType>::mapAll(void (*fn)(ValueType)) const {
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::mapAll(void (*fn)(ValueType)) const {
    for (int i = 0; i < count; i++) {
       fn(elements[i]);
    }
 }
 
-template <typename ValueType>
-void Vector<ValueType>::mapAll(void (*fn)(const ValueType &)) const {
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::mapAll(void (*fn)(const ValueType &)) const {
    for (int i = 0; i < count; i++) {
       fn(elements[i]);
    }
 }
 
-template <typename ValueType>
+template <typename ValueType, typename Allocator>
 template <typename FunctorType>
-void Vector<ValueType>::mapAll(FunctorType fn) const {
+void Vector<ValueType, Allocator>::mapAll(FunctorType fn) const {
    for (int i = 0; i < count; i++) {
       fn(elements[i]);
    }
@@ -633,19 +722,45 @@ void Vector<ValueType>::mapAll(FunctorType fn) const {
 /*
  * Implementation notes: expandCapacity
  * ------------------------------------
- * This function doubles the array capacity, copies the old elements into
- * the new array, and then frees the old one.
+ * This function doubles the array capacity.  The function reallocate moves
+ * the old elements into a new array of the given size, and then frees the
+ * old one.
  */
 
-template <typename ValueType>
-void Vector<ValueType>::expandCapacity() {
-   capacity = max(1, capacity * 2);
-   ValueType *array = new ValueType[capacity];
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::expandCapacity() {
+   INSTRUMENT_SCOPE(PROBE_VECTOR_EXPAND);
+   INSTRUMENT_BYTES((uint64_t) count * sizeof(ValueType));
+   reallocate(std::max(1, capacity * 2));
+}
+
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::reallocate(int newCapacity) {
+   ValueType *array = Traits::allocate(alloc, newCapacity);
    for (int i = 0; i < count; i++) {
-      array[i] = elements[i];
+      Traits::construct(alloc, array + i, std::move(elements[i]));
+      Traits::destroy(alloc, elements + i);
    }
-   if (elements != NULL) delete[] elements;
+   if (elements != NULL) Traits::deallocate(alloc, elements, capacity);
    elements = array;
+   capacity = newCapacity;
+}
+
+/*
+ * Implementation notes: release
+ * -----------------------------
+ * Destroys the elements, returns the array to the allocator and leaves
+ * the vector empty with no storage.
+ */
+
+template <typename ValueType, typename Allocator>
+void Vector<ValueType, Allocator>::release() {
+   for (int i = 0; i < count; i++) {
+      Traits::destroy(alloc, elements + i);
+   }
+   if (elements != NULL) Traits::deallocate(alloc, elements, capacity);
+   count = capacity = 0;
+   elements = NULL;
 }
 
 /*
@@ -656,8 +771,8 @@ void Vector<ValueType>::expandCapacity() {
  * specially.
  */
 
-template <typename ValueType>
-std::ostream & operator<<(std::ostream & os, const Vector<ValueType> & vec) {
+template <typename ValueType, typename Allocator>
+std::ostream & operator<<(std::ostream & os, const Vector<ValueType, Allocator> & vec) {
    os << "{";
    int len = vec.size();
    for (int i = 0; i < len; i++) {
@@ -667,8 +782,8 @@ std::ostream & operator<<(std::ostream & os, const Vector<ValueType> & vec) {
    return os << "}";
 }
 
-template <typename ValueType>
-std::istream & operator>>(std::istream & is, Vector<ValueType> & vec) {
+template <typename ValueType, typename Allocator>
+std::istream & operator>>(std::istream & is, Vector<ValueType, Allocator> & vec) {
    char ch;
    is >> ch;
    if (ch != '{') error("operator >>: Missing {");